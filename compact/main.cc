@@ -0,0 +1,96 @@
+/*
+ *    Copyright 2023 The ChampSim Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/***
+ * Converts a ChampSim trace (.xz or .gz) into the compact trace format (see
+ * compact_trace.h), one pass over the trace. The file offset of every block
+ * is written next to it, in OUTPUT.idx, so that --skip_instructions can go
+ * straight to the block it needs.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "compact_trace.h"
+#include "trace_decoder.h"
+
+int main(int argc, char** argv)
+{
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <input trace (.xz or .gz)> <output trace (.cst)>" << std::endl;
+    return 1;
+  }
+
+  std::string output_name = argv[2];
+  FILE* out = std::fopen(output_name.c_str(), "wb");
+  if (out == nullptr) {
+    std::cerr << "*** CANNOT WRITE COMPACT TRACE: " << output_name << " ***" << std::endl;
+    return 1;
+  }
+
+  champsim::trace_decoder decoder{argv[1], sizeof(input_instr)};
+  std::size_t reader = decoder.attach();
+
+  std::vector<input_instr> pending;
+  std::vector<uint64_t> block_offsets;
+  std::vector<uint8_t> encoded{std::begin(champsim::compact_trace::MAGIC), std::end(champsim::compact_trace::MAGIC)};
+  uint64_t instructions = 0, written = 0;
+  bool write_failed = false;
+
+  auto flush = [&] {
+    block_offsets.push_back(written + encoded.size());
+    champsim::compact_trace::encode_block(pending.data(), pending.data() + pending.size(), encoded);
+    // a short write would leave the index pointing past the data
+    if (std::fwrite(encoded.data(), 1, encoded.size(), out) != encoded.size())
+      write_failed = true;
+    written += encoded.size();
+    pending.clear();
+    encoded.clear();
+  };
+
+  bool end_of_trace = false;
+  for (uint64_t index = 0; !end_of_trace && !write_failed; ++index) {
+    auto c = decoder.get(reader, index);
+    for (std::size_t offset = 0; offset < c->size; offset += sizeof(input_instr)) {
+      std::memcpy(&pending.emplace_back(), c->data.get() + offset, sizeof(input_instr));
+      if (pending.size() == champsim::compact_trace::BLOCK_RECORDS)
+        flush();
+    }
+    instructions += c->size / sizeof(input_instr);
+    end_of_trace = c->end_of_trace;
+  }
+  if (!pending.empty() && !write_failed)
+    flush();
+
+  if (std::fclose(out) != 0 || write_failed || written == 0) {
+    std::cerr << "*** CANNOT WRITE COMPACT TRACE: " << output_name << " ***" << std::endl;
+    return 1;
+  }
+
+  std::string index_name = output_name + ".idx";
+  FILE* index = std::fopen(index_name.c_str(), "wb");
+  if (index == nullptr || std::fwrite(block_offsets.data(), sizeof(uint64_t), block_offsets.size(), index) != block_offsets.size() || std::fclose(index) != 0) {
+    std::cerr << "*** CANNOT WRITE COMPACT TRACE INDEX: " << index_name << " ***" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Wrote " << instructions << " instructions to " << output_name << ": " << written << " bytes, " << std::fixed << std::setprecision(2)
+            << (double)written / instructions << " bytes per instruction" << std::endl;
+}
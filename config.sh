@@ -31,11 +31,23 @@ fname_translation_table = str.maketrans('./-','_DH')
 def norm_fname(fname):
     return os.path.relpath(os.path.expandvars(os.path.expanduser(fname)))
 
+def dispatch_body(type_var, enum_name, calls, what):
+    # A single configured module is called directly, with no test on the type.
+    # Otherwise the type is switched on, which compiles to a jump table.
+    calls = sorted(calls)
+    if len(calls) == 1:
+        return '    return {};\n'.format(calls[0][1])
+    body = '    switch ({}) {{\n'.format(type_var)
+    body += ''.join('    case {}::{}: return {};\n'.format(enum_name, n, c) for n,c in calls)
+    body += '    }\n'
+    body += '    throw std::invalid_argument("{} module not found");\n'.format(what)
+    return body
+
 ###
 # Begin format strings
 ###
 
-cache_fmtstr = 'CACHE {name}("{name}", {frequency}, {fill_level}, {sets}, {ways}, {wq_size}, {rq_size}, {pq_size}, {mshr_size}, {hit_latency}, {fill_latency}, {max_read}, {max_write}, {offset_bits}, {prefetch_as_load:b}, {wq_check_full_addr:b}, {virtual_prefetch:b}, {prefetch_activate_mask}, {lower_level}, CACHE::pref_t::{prefetcher_name}, CACHE::repl_t::{replacement_name});\n'
+cache_fmtstr = 'CACHE {name}("{name}", {frequency}, {fill_level}, {sets}, {ways}, {wq_size}, {rq_size}, {pq_size}, {mshr_size}, {hit_latency}, {fill_latency}, {max_read}, {max_write}, {offset_bits}, {prefetch_as_load:b}, {wq_check_full_addr:b}, {virtual_prefetch:b}, {prefetch_activate_mask}, {lower_level}, CACHE::pref_t::{prefetcher_name}, CACHE::repl_t::{replacement_name}, "{capture}", {{{shadow_replacement_list}}}, {stack_distance_sampling}, {ebis_filter:b}, {prefetch_aware_replacement:b});\n'
 ptw_fmtstr = 'PageTableWalker {name}("{name}", {cpu}, {fill_level}, {pscl5_set}, {pscl5_way}, {pscl4_set}, {pscl4_way}, {pscl3_set}, {pscl3_way}, {pscl2_set}, {pscl2_way}, {ptw_rq_size}, {ptw_mshr_size}, {ptw_max_read}, {ptw_max_write}, 0, {lower_level});\n'
 
 cpu_fmtstr = 'O3_CPU {name}({index}, {frequency}, {DIB[sets]}, {DIB[ways]}, {DIB[window_size]}, {ifetch_buffer_size}, {dispatch_buffer_size}, {decode_buffer_size}, {rob_size}, {lq_size}, {sq_size}, {fetch_width}, {decode_width}, {dispatch_width}, {scheduler_size}, {execute_width}, {lq_width}, {sq_width}, {retire_width}, {mispredict_penalty}, {decode_latency}, {dispatch_latency}, {schedule_latency}, {execute_latency}, &{ITLB}, &{DTLB}, &{L1I}, &{L1D}, O3_CPU::bpred_t::{bpred_name}, O3_CPU::btb_t::{btb_name}, O3_CPU::ipref_t::{iprefetcher_name});\n'
@@ -183,6 +195,22 @@ caches = dict(itertools.compress(caches.items(), accessible))
 for cache in caches.values():
     cache['hit_latency'] = cache.get('hit_latency') or (cache['latency'] - cache['fill_latency'])
 
+# Access stream capture is off unless a file is named
+for cache in caches.values():
+    cache['capture'] = cache.get('capture') or ''
+
+# Stack distance profiling is off unless a sampling rate is given
+for cache in caches.values():
+    cache['stack_distance_sampling'] = cache.get('stack_distance_sampling') or 0
+    if not 0 <= cache['stack_distance_sampling'] <= 1:
+        print('The stack distance sampling rate of ' + cache['name'] + ' must be between 0 and 1. Exiting...')
+        sys.exit(1)
+
+# EbIS-aware replacement policies use the exact EbIS and treat prefetches like demand accesses unless told otherwise
+for cache in caches.values():
+    cache['ebis_filter'] = cache.get('ebis_filter', False)
+    cache['prefetch_aware_replacement'] = cache.get('prefetch_aware_replacement', False)
+
 # Create prefetch activation masks
 type_list = ('LOAD', 'RFO', 'PREFETCH', 'WRITEBACK', 'TRANSLATION')
 for cache in caches.values():
@@ -228,28 +256,41 @@ for cpu in cores:
 # Associate modules with paths
 libfilenames = {}
 
+def resolve_replacement(module):
+    fname = os.path.join('replacement', module)
+    if not os.path.exists(fname):
+        fname = norm_fname(module)
+    if not os.path.exists(fname):
+        print('Path "' + fname + '" does not exist. Exiting...')
+        sys.exit(1)
+
+    repl = {}
+    repl['replacement_fname'] = fname
+    repl['replacement_name'] = 'r' + fname.translate(fname_translation_table)
+    repl['replacement_initialize'] = 'repl_' + repl['replacement_name'] + '_initialize'
+    repl['replacement_find_victim'] = 'repl_' + repl['replacement_name'] + '_victim'
+    repl['replacement_update_replacement_state'] = 'repl_' + repl['replacement_name'] + '_update'
+    repl['replacement_cache_evict'] = 'repl_' + repl['replacement_name'] + '_evict'
+    repl['replacement_replacement_final_stats'] = 'repl_' + repl['replacement_name'] + '_final_stats'
+
+    opts = ''
+    opts += ' -Dinitialize_replacement=' + repl['replacement_initialize']
+    opts += ' -Dfind_victim=' + repl['replacement_find_victim']
+    opts += ' -Dupdate_replacement_state=' + repl['replacement_update_replacement_state']
+    opts += ' -Dreplacement_cache_evict=' + repl['replacement_cache_evict']
+    opts += ' -Dreplacement_final_stats=' + repl['replacement_replacement_final_stats']
+    libfilenames['repl_' + repl['replacement_name'] + '.a'] = (fname, opts)
+
+    return repl
+
 for cache in caches.values():
     # Resolve cache replacment function names
     if cache['replacement'] is not None:
-        fname = os.path.join('replacement', cache['replacement'])
-        if not os.path.exists(fname):
-            fname = norm_fname(cache['replacement'])
-        if not os.path.exists(fname):
-            print('Path "' + fname + '" does not exist. Exiting...')
-            sys.exit(1)
+        cache.update(resolve_replacement(cache['replacement']))
 
-        cache['replacement_name'] = 'r' + fname.translate(fname_translation_table)
-        cache['replacement_initialize'] = 'repl_' + cache['replacement_name'] + '_initialize'
-        cache['replacement_find_victim'] = 'repl_' + cache['replacement_name'] + '_victim'
-        cache['replacement_update_replacement_state'] = 'repl_' + cache['replacement_name'] + '_update'
-        cache['replacement_replacement_final_stats'] = 'repl_' + cache['replacement_name'] + '_final_stats'
-
-        opts = ''
-        opts += ' -Dinitialize_replacement=' + cache['replacement_initialize']
-        opts += ' -Dfind_victim=' + cache['replacement_find_victim']
-        opts += ' -Dupdate_replacement_state=' + cache['replacement_update_replacement_state']
-        opts += ' -Dreplacement_final_stats=' + cache['replacement_replacement_final_stats']
-        libfilenames['repl_' + cache['replacement_name'] + '.a'] = (fname, opts)
+    # Shadow policies are built like any other replacement module
+    cache['shadow_replacement'] = [resolve_replacement(r) for r in cache.get('shadow_replacement', [])]
+    cache['shadow_replacement_list'] = ', '.join('{{CACHE::repl_t::{}, "{}"}}'.format(r['replacement_name'], os.path.basename(r['replacement_fname'])) for r in cache['shadow_replacement'])
 
     # Resolve prefetcher function names
     if cache['prefetcher'] is not None:
@@ -489,24 +530,21 @@ with open('inc/ooo_cpu_modules.inc', 'wt') as wfp:
     wfp.write('\n};\n\n')
 
     wfp.write('\n'.join('void {1}();'.format(*b) for b in bpred_inits))
-    wfp.write('\nvoid impl_branch_predictor_initialize()\n{\n    ')
-    wfp.write('\n    '.join('if (bpred_type == bpred_t::{}) return {}();'.format(*b) for b in bpred_inits))
-    wfp.write('\n    throw std::invalid_argument("Branch predictor module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\nvoid impl_branch_predictor_initialize()\n{\n')
+    wfp.write(dispatch_body('bpred_type', 'bpred_t', ((n, '{}()'.format(f)) for n,f in bpred_inits), 'Branch predictor'))
+    wfp.write('}\n')
     wfp.write('\n')
 
     wfp.write('\n'.join('void {1}(uint64_t, uint64_t, uint8_t, uint8_t);'.format(*b) for b in bpred_last_results))
-    wfp.write('\nvoid impl_last_branch_result(uint64_t ip, uint64_t target, uint8_t taken, uint8_t branch_type)\n{\n    ')
-    wfp.write('\n    '.join('if (bpred_type == bpred_t::{}) return {}(ip, target, taken, branch_type);'.format(*b) for b in bpred_last_results))
-    wfp.write('\n    throw std::invalid_argument("Branch predictor module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\nvoid impl_last_branch_result(uint64_t ip, uint64_t target, uint8_t taken, uint8_t branch_type)\n{\n')
+    wfp.write(dispatch_body('bpred_type', 'bpred_t', ((n, '{}(ip, target, taken, branch_type)'.format(f)) for n,f in bpred_last_results), 'Branch predictor'))
+    wfp.write('}\n')
     wfp.write('\n')
 
     wfp.write('\n'.join('uint8_t {1}(uint64_t, uint64_t, uint8_t, uint8_t);'.format(*b) for b in bpred_predicts))
-    wfp.write('\nuint8_t impl_predict_branch(uint64_t ip, uint64_t predicted_target, uint8_t always_taken, uint8_t branch_type)\n{\n    ')
-    wfp.write('\n    '.join('if (bpred_type == bpred_t::{}) return {}(ip, predicted_target, always_taken, branch_type);'.format(*b) for b in bpred_predicts))
-    wfp.write('\n    throw std::invalid_argument("Branch predictor module not found");')
-    wfp.write('\n    return 0;\n}\n\n')
+    wfp.write('\nuint8_t impl_predict_branch(uint64_t ip, uint64_t predicted_target, uint8_t always_taken, uint8_t branch_type)\n{\n')
+    wfp.write(dispatch_body('bpred_type', 'bpred_t', ((n, '{}(ip, predicted_target, always_taken, branch_type)'.format(f)) for n,f in bpred_predicts), 'Branch predictor'))
+    wfp.write('}\n\n')
 
     wfp.write('enum class btb_t\n{\n    ')
     wfp.write(',\n    '.join(btb_names))
@@ -514,24 +552,21 @@ with open('inc/ooo_cpu_modules.inc', 'wt') as wfp:
     wfp.write('\n')
 
     wfp.write('\n'.join('void {1}();'.format(*b) for b in btb_inits))
-    wfp.write('\nvoid impl_btb_initialize()\n{\n    ')
-    wfp.write('\n    '.join('if (btb_type == btb_t::{}) return {}();'.format(*b) for b in btb_inits))
-    wfp.write('\n    throw std::invalid_argument("Branch target buffer module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\nvoid impl_btb_initialize()\n{\n')
+    wfp.write(dispatch_body('btb_type', 'btb_t', ((n, '{}()'.format(f)) for n,f in btb_inits), 'Branch target buffer'))
+    wfp.write('}\n')
     wfp.write('\n')
 
     wfp.write('\n'.join('void {1}(uint64_t, uint64_t, uint8_t, uint8_t);'.format(*b) for b in btb_updates))
-    wfp.write('\nvoid impl_update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)\n{\n    ')
-    wfp.write('\n    '.join('if (btb_type == btb_t::{}) return {}(ip, branch_target, taken, branch_type);'.format(*b) for b in btb_updates))
-    wfp.write('\n    throw std::invalid_argument("Branch target buffer module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\nvoid impl_update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)\n{\n')
+    wfp.write(dispatch_body('btb_type', 'btb_t', ((n, '{}(ip, branch_target, taken, branch_type)'.format(f)) for n,f in btb_updates), 'Branch target buffer'))
+    wfp.write('}\n')
     wfp.write('\n')
 
     wfp.write('\n'.join('std::pair<uint64_t, uint8_t> {1}(uint64_t, uint8_t);'.format(*b) for b in btb_predicts))
-    wfp.write('\nstd::pair<uint64_t, uint8_t> impl_btb_prediction(uint64_t ip, uint8_t branch_type)\n{\n    ')
-    wfp.write('\n    '.join('if (btb_type == btb_t::{}) return {}(ip, branch_type);'.format(*b) for b in btb_predicts))
-    wfp.write('\n    throw std::invalid_argument("Branch target buffer module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\nstd::pair<uint64_t, uint8_t> impl_btb_prediction(uint64_t ip, uint8_t branch_type)\n{\n')
+    wfp.write(dispatch_body('btb_type', 'btb_t', ((n, '{}(ip, branch_type)'.format(f)) for n,f in btb_predicts), 'Branch target buffer'))
+    wfp.write('}\n')
     wfp.write('\n')
 
     wfp.write('enum class ipref_t\n{\n    ')
@@ -547,10 +582,9 @@ with open('inc/ooo_cpu_modules.inc', 'wt') as wfp:
     wfp.write('\n')
 
     wfp.write('\n'.join('void {1}(uint64_t, uint8_t, uint64_t);'.format(*i) for i in ipref_branch_ops))
-    wfp.write('\nvoid impl_prefetcher_branch_operate(uint64_t ip, uint8_t branch_type, uint64_t branch_target)\n{\n    ')
-    wfp.write('\n    '.join('if (ipref_type == ipref_t::{}) return {}(ip, branch_type, branch_target);'.format(*i) for i in ipref_branch_ops))
-    wfp.write('\n    throw std::invalid_argument("Instruction prefetcher module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\nvoid impl_prefetcher_branch_operate(uint64_t ip, uint8_t branch_type, uint64_t branch_target)\n{\n')
+    wfp.write(dispatch_body('ipref_type', 'ipref_t', ((n, '{}(ip, branch_type, branch_target)'.format(f)) for n,f in ipref_branch_ops), 'Instruction prefetcher'))
+    wfp.write('}\n')
     wfp.write('\n')
 
     wfp.write('\n'.join('uint32_t {1}(uint64_t, uint8_t, uint8_t, uint32_t);'.format(*i) for i in ipref_cache_ops))
@@ -561,10 +595,9 @@ with open('inc/ooo_cpu_modules.inc', 'wt') as wfp:
     wfp.write('\n')
 
     wfp.write('\n'.join('void {1}();'.format(*i) for i in ipref_cycle_ops))
-    wfp.write('\nvoid impl_prefetcher_cycle_operate()\n{\n    ')
-    wfp.write('\n    '.join('if (ipref_type == ipref_t::{}) return {}();'.format(*i) for i in ipref_cycle_ops))
-    wfp.write('\n    throw std::invalid_argument("Instruction prefetcher module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\nvoid impl_prefetcher_cycle_operate()\n{\n')
+    wfp.write(dispatch_body('ipref_type', 'ipref_t', ((n, '{}()'.format(f)) for n,f in ipref_cycle_ops), 'Instruction prefetcher'))
+    wfp.write('}\n')
     wfp.write('\n')
 
     wfp.write('\n'.join('uint32_t {1}(uint64_t, uint32_t, uint32_t, uint8_t, uint64_t, uint32_t);'.format(*i) for i in ipref_fill))
@@ -582,11 +615,13 @@ with open('inc/ooo_cpu_modules.inc', 'wt') as wfp:
     wfp.write('\n')
 
 # Cache modules file
-repl_names   = {c['replacement_name'] for c in caches.values()}
-repl_inits   = {(c['replacement_name'], c['replacement_initialize']) for c in caches.values()}
-repl_victims = {(c['replacement_name'], c['replacement_find_victim']) for c in caches.values()}
-repl_updates = {(c['replacement_name'], c['replacement_update_replacement_state']) for c in caches.values()}
-repl_finals  = {(c['replacement_name'], c['replacement_replacement_final_stats']) for c in caches.values()}
+repls        = list(itertools.chain(caches.values(), *(c['shadow_replacement'] for c in caches.values())))
+repl_names   = {c['replacement_name'] for c in repls}
+repl_inits   = {(c['replacement_name'], c['replacement_initialize']) for c in repls}
+repl_victims = {(c['replacement_name'], c['replacement_find_victim']) for c in repls}
+repl_updates = {(c['replacement_name'], c['replacement_update_replacement_state']) for c in repls}
+repl_evicts  = {(c['replacement_name'], c['replacement_cache_evict']) for c in repls}
+repl_finals  = {(c['replacement_name'], c['replacement_replacement_final_stats']) for c in repls}
 pref_names   = {c['prefetcher_name'] for c in caches.values()}
 pref_inits   = {(c['prefetcher_name'], c['prefetcher_initialize']) for c in caches.values()}
 pref_ops     = {(c['prefetcher_name'], c['prefetcher_cache_operate']) for c in caches.values()}
@@ -595,81 +630,78 @@ pref_cycles  = {(c['prefetcher_name'], c['prefetcher_cycle_operate']) for c in c
 pref_finals  = {(c['prefetcher_name'], c['prefetcher_final_stats']) for c in caches.values()}
 with open('inc/cache_modules.inc', 'wt') as wfp:
     wfp.write('enum class repl_t\n{\n    ')
-    wfp.write(',\n    '.join(repl_names))
+    wfp.write(',\n    '.join(sorted(repl_names)))
     wfp.write('\n};\n')
     wfp.write('\n')
 
-    wfp.write('\n'.join('void {1}();'.format(*r) for r in repl_inits))
-    wfp.write('\nvoid impl_replacement_initialize()\n{\n    ')
-    wfp.write('\n    '.join('if (repl_type == repl_t::{}) return {}();'.format(*r) for r in repl_inits))
-    wfp.write('\n    throw std::invalid_argument("Replacement policy module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\n'.join('void {1}();'.format(*r) for r in sorted(repl_inits)))
+    wfp.write('\nvoid impl_replacement_initialize()\n{\n')
+    wfp.write(dispatch_body('repl_type', 'repl_t', ((n, '{}()'.format(f)) for n,f in repl_inits), 'Replacement policy'))
+    wfp.write('}\n')
+    wfp.write('\n')
+
+    wfp.write('\n'.join('uint32_t {1}(uint32_t, uint64_t, uint32_t, const BLOCK*, uint64_t, uint64_t, uint32_t);'.format(*r) for r in sorted(repl_victims)))
+    wfp.write('\nuint32_t impl_replacement_find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK* current_set, uint64_t ip, uint64_t full_addr, uint32_t type)\n{\n')
+    wfp.write(dispatch_body('repl_type', 'repl_t', ((n, '{}(cpu, instr_id, set, current_set, ip, full_addr, type)'.format(f)) for n,f in repl_victims), 'Replacement policy'))
+    wfp.write('}\n')
     wfp.write('\n')
 
-    wfp.write('\n'.join('uint32_t {1}(uint32_t, uint64_t, uint32_t, const BLOCK*, uint64_t, uint64_t, uint32_t);'.format(*r) for r in repl_victims))
-    wfp.write('\nuint32_t impl_replacement_find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK* current_set, uint64_t ip, uint64_t full_addr, uint32_t type)\n{\n    ')
-    wfp.write('\n    '.join('if (repl_type == repl_t::{}) return {}(cpu, instr_id, set, current_set, ip, full_addr, type);'.format(*r) for r in repl_victims))
-    wfp.write('\n    throw std::invalid_argument("Replacement policy module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\n'.join('void {1}(uint32_t, uint32_t, uint32_t, uint64_t, uint64_t, uint64_t, uint32_t, uint8_t);'.format(*r) for r in sorted(repl_updates)))
+    wfp.write('\nvoid impl_replacement_update_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)\n{\n')
+    wfp.write(dispatch_body('repl_type', 'repl_t', ((n, '{}(cpu, set, way, full_addr, ip, victim_addr, type, hit)'.format(f)) for n,f in repl_updates), 'Replacement policy'))
+    wfp.write('}\n')
     wfp.write('\n')
 
-    wfp.write('\n'.join('void {1}(uint32_t, uint32_t, uint32_t, uint64_t, uint64_t, uint64_t, uint32_t, uint8_t);'.format(*r) for r in repl_updates))
-    wfp.write('\nvoid impl_replacement_update_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)\n{\n    ')
-    wfp.write('\n    '.join('if (repl_type == repl_t::{}) return {}(cpu, set, way, full_addr, ip, victim_addr, type, hit);'.format(*r) for r in repl_updates))
-    wfp.write('\n    throw std::invalid_argument("Replacement policy module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\n'.join('void {1}(uint32_t, uint32_t, const BLOCK&);'.format(*r) for r in sorted(repl_evicts)))
+    wfp.write('\nvoid impl_replacement_cache_evict(uint32_t set, uint32_t way, const BLOCK& evicted)\n{\n')
+    wfp.write(dispatch_body('repl_type', 'repl_t', ((n, '{}(set, way, evicted)'.format(f)) for n,f in repl_evicts), 'Replacement policy'))
+    wfp.write('}\n')
     wfp.write('\n')
 
-    wfp.write('\n'.join('void {1}();'.format(*r) for r in repl_finals))
-    wfp.write('\nvoid impl_replacement_final_stats()\n{\n    ')
-    wfp.write('\n    '.join('if (repl_type == repl_t::{}) return {}();'.format(*r) for r in repl_finals))
-    wfp.write('\n    throw std::invalid_argument("Replacement policy module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\n'.join('void {1}();'.format(*r) for r in sorted(repl_finals)))
+    wfp.write('\nvoid impl_replacement_final_stats()\n{\n')
+    wfp.write(dispatch_body('repl_type', 'repl_t', ((n, '{}()'.format(f)) for n,f in repl_finals), 'Replacement policy'))
+    wfp.write('}\n')
     wfp.write('\n')
 
     wfp.write('enum class pref_t\n{\n    ')
-    wfp.write(',\n    '.join(pref_names))
+    wfp.write(',\n    '.join(sorted(pref_names)))
     wfp.write('\n};\n')
     wfp.write('\n')
 
-    wfp.write('\n'.join('void {1}();'.format(*p) for p in pref_inits if not p[0].startswith('CPU_REDIRECT')))
-    wfp.write('\nvoid impl_prefetcher_initialize()\n{\n    ')
-    pref_inits = { (n, ('ooo_cpu[cpu]->' if n.startswith('CPU_REDIRECT') else '') + f) for n,f in pref_inits } ## prepend redirect
-    wfp.write('\n    '.join('if (pref_type == pref_t::{}) return {}();'.format(*p) for p in pref_inits))
-    wfp.write('\n    throw std::invalid_argument("Data prefetcher module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\n'.join('void {1}();'.format(*p) for p in sorted(pref_inits) if not p[0].startswith('CPU_REDIRECT')))
+    wfp.write('\nvoid impl_prefetcher_initialize()\n{\n')
+    pref_inits = { (n, ('ooo_cpu[cpu]->' if n.startswith('CPU_REDIRECT') else '') + f + '()') for n,f in pref_inits } ## prepend redirect
+    wfp.write(dispatch_body('pref_type', 'pref_t', pref_inits, 'Data prefetcher'))
+    wfp.write('}\n')
     wfp.write('\n')
 
-    wfp.write('\n'.join('uint32_t {1}(uint64_t, uint64_t, uint8_t, uint8_t, uint32_t);'.format(*p) for p in pref_ops if not p[0].startswith('CPU_REDIRECT')))
-    wfp.write('\nuint32_t impl_prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type, uint32_t metadata_in)\n{\n    ')
+    wfp.write('\n'.join('uint32_t {1}(uint64_t, uint64_t, uint8_t, uint8_t, uint32_t);'.format(*p) for p in sorted(pref_ops) if not p[0].startswith('CPU_REDIRECT')))
+    wfp.write('\nuint32_t impl_prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type, uint32_t metadata_in)\n{\n')
     pref_ops = { (n, ('ooo_cpu[cpu]->{}(addr, cache_hit, (type == PREFETCH), metadata_in)' if n.startswith('CPU_REDIRECT') else '{}(addr, ip, cache_hit, type, metadata_in)').format(f)) for n,f in pref_ops } ## modify signature for redirect
-    wfp.write('\n    '.join('if (pref_type == pref_t::{}) return {};'.format(*p) for p in pref_ops))
-    wfp.write('\n    throw std::invalid_argument("Data prefetcher module not found");')
-    wfp.write('\n}\n')
+    wfp.write(dispatch_body('pref_type', 'pref_t', pref_ops, 'Data prefetcher'))
+    wfp.write('}\n')
     wfp.write('\n')
 
-    wfp.write('\n'.join('uint32_t {1}(uint64_t, uint32_t, uint32_t, uint8_t, uint64_t, uint32_t);'.format(*p) for p in pref_fill if not p[0].startswith('CPU_REDIRECT')))
-    wfp.write('\nuint32_t impl_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in)\n{\n    ')
-    pref_fill = { (n, ('ooo_cpu[cpu]->' if n.startswith('CPU_REDIRECT') else '') + f) for n,f in pref_fill } ## prepend redirect
-    wfp.write('\n    '.join('if (pref_type == pref_t::{}) return {}(addr, set, way, prefetch, evicted_addr, metadata_in);'.format(*p) for p in pref_fill))
-    wfp.write('\n    throw std::invalid_argument("Data prefetcher module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\n'.join('uint32_t {1}(uint64_t, uint32_t, uint32_t, uint8_t, uint64_t, uint32_t);'.format(*p) for p in sorted(pref_fill) if not p[0].startswith('CPU_REDIRECT')))
+    wfp.write('\nuint32_t impl_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in)\n{\n')
+    pref_fill = { (n, ('ooo_cpu[cpu]->' if n.startswith('CPU_REDIRECT') else '') + f + '(addr, set, way, prefetch, evicted_addr, metadata_in)') for n,f in pref_fill } ## prepend redirect
+    wfp.write(dispatch_body('pref_type', 'pref_t', pref_fill, 'Data prefetcher'))
+    wfp.write('}\n')
     wfp.write('\n')
 
-    wfp.write('\n'.join('void {1}();'.format(*p) for p in pref_cycles if not p[0].startswith('CPU_REDIRECT')))
-    wfp.write('\nvoid impl_prefetcher_cycle_operate()\n{\n    ')
-    pref_cycles = { (n, ('ooo_cpu[cpu]->' if n.startswith('CPU_REDIRECT') else '') + f) for n,f in pref_cycles } ## prepend redirect
-    wfp.write('\n    '.join('if (pref_type == pref_t::{}) return {}();'.format(*p) for p in pref_cycles))
-    wfp.write('\n    throw std::invalid_argument("Data prefetcher module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\n'.join('void {1}();'.format(*p) for p in sorted(pref_cycles) if not p[0].startswith('CPU_REDIRECT')))
+    wfp.write('\nvoid impl_prefetcher_cycle_operate()\n{\n')
+    pref_cycles = { (n, ('ooo_cpu[cpu]->' if n.startswith('CPU_REDIRECT') else '') + f + '()') for n,f in pref_cycles } ## prepend redirect
+    wfp.write(dispatch_body('pref_type', 'pref_t', pref_cycles, 'Data prefetcher'))
+    wfp.write('}\n')
     wfp.write('\n')
 
-    wfp.write('\n'.join('void {1}();'.format(*p) for p in pref_finals if not p[0].startswith('CPU_REDIRECT')))
-    wfp.write('\nvoid impl_prefetcher_final_stats()\n{\n    ')
-    pref_finals = { (n, ('ooo_cpu[cpu]->' if n.startswith('CPU_REDIRECT') else '') + f) for n,f in pref_finals } ## prepend redirect
-    wfp.write('\n    '.join('if (pref_type == pref_t::{}) return {}();'.format(*p) for p in pref_finals))
-    wfp.write('\n    throw std::invalid_argument("Data prefetcher module not found");')
-    wfp.write('\n}\n')
+    wfp.write('\n'.join('void {1}();'.format(*p) for p in sorted(pref_finals) if not p[0].startswith('CPU_REDIRECT')))
+    wfp.write('\nvoid impl_prefetcher_final_stats()\n{\n')
+    pref_finals = { (n, ('ooo_cpu[cpu]->' if n.startswith('CPU_REDIRECT') else '') + f + '()') for n,f in pref_finals } ## prepend redirect
+    wfp.write(dispatch_body('pref_type', 'pref_t', pref_finals, 'Data prefetcher'))
+    wfp.write('}\n')
     wfp.write('\n')
 
 # Constants header
@@ -702,11 +734,11 @@ with open('Makefile', 'wt') as wfp:
     wfp.write('CFLAGS := ' + config_file.get('CFLAGS', '-Wall -O3') + ' -std=gnu99\n')
     wfp.write('CXXFLAGS := ' + config_file.get('CXXFLAGS', '-Wall -O3') + ' -std=c++17\n')
     wfp.write('CPPFLAGS := ' + config_file.get('CPPFLAGS', '') + ' -Iinc -MMD -MP\n')
-    wfp.write('LDFLAGS := ' + config_file.get('LDFLAGS', '') + '\n')
-    wfp.write('LDLIBS := ' + config_file.get('LDLIBS', '') + '\n')
+    wfp.write('LDFLAGS := ' + config_file.get('LDFLAGS', '') + ' -pthread\n')
+    wfp.write('LDLIBS := ' + config_file.get('LDLIBS', '') + ' -llzma -lz\n')
     wfp.write('\n')
     wfp.write('.phony: all clean\n\n')
-    wfp.write('all: ' + config_file['executable_name'] + '\n\n')
+    wfp.write('all: ' + config_file['executable_name'] + ' ' + config_file['executable_name'] + '_replay ' + config_file['executable_name'] + '_compact\n\n')
     wfp.write('clean: \n')
     wfp.write('\t$(RM) ' + constants_header_name + '\n')
     wfp.write('\t$(RM) ' + instantiation_file_name + '\n')
@@ -718,11 +750,17 @@ with open('Makefile', 'wt') as wfp:
     wfp.write('\n')
     wfp.write(config_file['executable_name'] + ': $(patsubst %.cc,%.o,$(wildcard src/*.cc)) ' + ' '.join('obj/' + k for k in libfilenames) + '\n')
     wfp.write('\t$(CXX) $(LDFLAGS) -o $@ $^ $(LDLIBS)\n\n')
+    wfp.write(config_file['executable_name'] + '_replay: $(patsubst %.cc,%.o,$(filter-out src/main.cc,$(wildcard src/*.cc)) $(wildcard replay/*.cc)) ' + ' '.join('obj/' + k for k in libfilenames) + '\n')
+    wfp.write('\t$(CXX) $(LDFLAGS) -o $@ $^ $(LDLIBS)\n\n')
+    wfp.write(config_file['executable_name'] + '_compact: src/trace_decoder.o src/compact_trace.o $(patsubst %.cc,%.o,$(wildcard compact/*.cc))\n')
+    wfp.write('\t$(CXX) $(LDFLAGS) -o $@ $^ $(LDLIBS)\n\n')
 
     for k,v in libfilenames.items():
         wfp.write(module_make_fmtstr.format(k, *v))
 
     wfp.write('-include $(wildcard src/*.d)\n')
+    wfp.write('-include $(wildcard replay/*.d)\n')
+    wfp.write('-include $(wildcard compact/*.d)\n')
     for v in libfilenames.values():
         wfp.write('-include $(wildcard {0}/*.d)\n'.format(*v))
     wfp.write('\n')
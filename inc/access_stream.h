@@ -0,0 +1,259 @@
+#ifndef ACCESS_STREAM_H
+#define ACCESS_STREAM_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace champsim
+{
+namespace access_stream
+{
+
+/***
+ * A recorded stream of accesses to one cache, in the order the cache handled
+ * them.
+ *
+ * File layout (all integers little-endian):
+ *   file_header
+ *   block 0, block 1, ...          delta-encoded records, see block_encoder
+ *   block_info[num_blocks]         at header.index_offset
+ *
+ * Every block decodes on its own, so a reader can map the file and start at
+ * any block through the index. The header is rewritten when the file is
+ * closed; a zero index_offset marks a capture that never finished.
+ */
+struct access {
+  uint64_t cycle = 0;
+  uint64_t address = 0;
+  uint64_t ip = 0;
+  uint32_t cpu = 0;
+  uint8_t type = 0;  // LOAD, RFO, PREFETCH, WRITEBACK or TRANSLATION
+  bool hit = false;  // the access found its block in the cache
+  bool fill = false; // the access is the fill of an earlier miss
+};
+
+constexpr char MAGIC[8] = {'C', 'S', 'A', 'C', 'C', 'E', 'S', 'S'};
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t RECORDS_PER_BLOCK = 1 << 16;
+
+struct file_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t records_per_block;
+  uint64_t num_records;
+  uint64_t num_blocks;
+  uint64_t index_offset;
+};
+
+struct block_info {
+  uint64_t offset;       // of the block from the start of the file
+  uint64_t first_record; // number of records in all earlier blocks
+  uint64_t first_cycle;  // cycle of the block's first record
+  uint32_t num_records;
+  uint32_t size; // bytes
+};
+
+/*
+ * Records are packed as
+ *   flags     type in bits 0-2, hit in bit 3, fill in bit 4,
+ *             bit 5 set if a cpu follows, bit 6 set if the ip repeats
+ *   [cpu]     varint, only when it differs from the previous record
+ *   cycle     varint, difference from the previous record
+ *   address   zigzag varint, difference from the previous record
+ *   [ip]      zigzag varint, difference from the previous record
+ * The previous record starts out as {first_cycle, address 0, ip 0, cpu 0} at
+ * the start of every block.
+ */
+namespace detail
+{
+enum : uint8_t { TYPE_MASK = 0x7, HIT = 1 << 3, FILL = 1 << 4, NEW_CPU = 1 << 5, SAME_IP = 1 << 6 };
+
+inline void put_varint(std::vector<uint8_t>& out, uint64_t val)
+{
+  while (val >= 0x80) {
+    out.push_back(static_cast<uint8_t>(val | 0x80));
+    val >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(val));
+}
+
+inline uint64_t get_varint(const uint8_t*& in)
+{
+  uint64_t val = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    uint8_t byte = *in++;
+    val |= uint64_t{byte & 0x7fu} << shift;
+    if (!(byte & 0x80))
+      return val;
+  }
+}
+
+inline uint64_t zigzag(uint64_t delta) { return (delta << 1) ^ (0 - (delta >> 63)); }
+inline uint64_t unzigzag(uint64_t val) { return (val >> 1) ^ (0 - (val & 1)); }
+} // namespace detail
+
+class block_encoder
+{
+  std::vector<uint8_t> bytes;
+  access prev;
+  uint64_t first_cycle = 0;
+  uint32_t count = 0;
+
+public:
+  void push(const access& acc)
+  {
+    if (count == 0) {
+      bytes.reserve(8 * RECORDS_PER_BLOCK);
+      prev = access{};
+      prev.cycle = first_cycle = acc.cycle;
+    }
+
+    uint8_t flags = (acc.type & detail::TYPE_MASK) | (acc.hit ? detail::HIT : 0) | (acc.fill ? detail::FILL : 0);
+    if (acc.cpu != prev.cpu)
+      flags |= detail::NEW_CPU;
+    if (acc.ip == prev.ip)
+      flags |= detail::SAME_IP;
+
+    bytes.push_back(flags);
+    if (flags & detail::NEW_CPU)
+      detail::put_varint(bytes, acc.cpu);
+    detail::put_varint(bytes, acc.cycle - prev.cycle);
+    detail::put_varint(bytes, detail::zigzag(acc.address - prev.address));
+    if (!(flags & detail::SAME_IP))
+      detail::put_varint(bytes, detail::zigzag(acc.ip - prev.ip));
+
+    prev = acc;
+    count++;
+  }
+
+  bool empty() const { return count == 0; }
+  bool full() const { return count == RECORDS_PER_BLOCK; }
+  uint32_t size() const { return count; }
+  uint64_t start_cycle() const { return first_cycle; }
+
+  // hand over the encoded bytes and start a new block
+  std::vector<uint8_t> take()
+  {
+    count = 0;
+    return std::move(bytes);
+  }
+};
+
+class block_decoder
+{
+  const uint8_t* next;
+  uint32_t remaining;
+  access prev;
+
+public:
+  block_decoder(const uint8_t* begin, const block_info& info) : next(begin), remaining(info.num_records) { prev.cycle = info.first_cycle; }
+
+  bool done() const { return remaining == 0; }
+
+  access get()
+  {
+    uint8_t flags = *next++;
+    access acc;
+    acc.type = flags & detail::TYPE_MASK;
+    acc.hit = flags & detail::HIT;
+    acc.fill = flags & detail::FILL;
+    acc.cpu = (flags & detail::NEW_CPU) ? static_cast<uint32_t>(detail::get_varint(next)) : prev.cpu;
+    acc.cycle = prev.cycle + detail::get_varint(next);
+    acc.address = prev.address + detail::unzigzag(detail::get_varint(next));
+    acc.ip = (flags & detail::SAME_IP) ? prev.ip : prev.ip + detail::unzigzag(detail::get_varint(next));
+
+    prev = acc;
+    remaining--;
+    return acc;
+  }
+};
+
+/***
+ * Writes a capture file. Records are encoded on the calling thread; full
+ * blocks are handed to a background thread that writes them out, so the
+ * simulation only waits if the disk falls several blocks behind. The index
+ * and header are written when the writer is destroyed.
+ */
+class writer
+{
+  static constexpr std::size_t MAX_PENDING = 8;
+
+  struct pending_block {
+    std::vector<uint8_t> bytes;
+    uint64_t first_cycle;
+    uint32_t num_records;
+  };
+
+  std::string path;
+  FILE* fp = nullptr;
+  block_encoder current;
+
+  std::mutex mtx;
+  std::condition_variable have_work, have_room;
+  std::deque<pending_block> pending;
+  bool closing = false;
+
+  // owned by the background thread until it is joined
+  std::vector<block_info> index;
+  uint64_t offset = sizeof(file_header), num_records = 0;
+
+  std::thread io_thread;
+
+  void flush_block();
+  void run();
+
+public:
+  explicit writer(std::string path);
+  writer(const writer&) = delete;
+  writer& operator=(const writer&) = delete;
+  ~writer();
+
+  void push(const access& acc)
+  {
+    current.push(acc);
+    if (current.full())
+      flush_block();
+  }
+};
+
+/***
+ * Read-only view of a finished capture file, mapped into memory.
+ */
+class reader
+{
+  const uint8_t* base = nullptr;
+  std::size_t length = 0;
+  const file_header* header = nullptr;
+  const block_info* index = nullptr;
+
+public:
+  explicit reader(std::string path);
+  reader(const reader&) = delete;
+  reader& operator=(const reader&) = delete;
+  ~reader();
+
+  uint64_t size() const { return header->num_records; }
+  uint64_t num_blocks() const { return header->num_blocks; }
+  const block_info& block(std::size_t i) const { return index[i]; }
+  block_decoder decode(std::size_t i) const { return block_decoder{base + index[i].offset, index[i]}; }
+
+  // call f(const access&) for every record, in order
+  template <typename F>
+  void for_each(F&& f) const
+  {
+    for (std::size_t i = 0; i < num_blocks(); ++i)
+      for (auto dec = decode(i); !dec.done();)
+        f(dec.get());
+  }
+};
+
+} // namespace access_stream
+} // namespace champsim
+
+#endif
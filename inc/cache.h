@@ -19,20 +19,30 @@
 
 #include <functional>
 #include <list>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "access_stream.h"
 #include "champsim.h"
 #include "delay_queue.hpp"
 #include "memory_class.h"
 #include "ooo_cpu.h"
 #include "operable.h"
+#include "stack_distance.h"
+#include "tag_array.h"
 
 // virtual address space prefetching
 #define VA_PREFETCH_TRANSLATION_LATENCY 2
 
 extern std::array<O3_CPU*, NUM_CPUS> ooo_cpu;
 
+namespace champsim
+{
+class shadow_group;
+}
+
 class CACHE : public champsim::operable, public MemoryRequestConsumer, public MemoryRequestProducer
 {
 public:
@@ -41,12 +51,14 @@ public:
   const uint32_t NUM_SET, NUM_WAY, WQ_SIZE, RQ_SIZE, PQ_SIZE, MSHR_SIZE;
   const uint32_t HIT_LATENCY, FILL_LATENCY, OFFSET_BITS;
   std::vector<BLOCK> block{NUM_SET * NUM_WAY};
+  champsim::tag_array tags{NUM_SET, NUM_WAY, NUM_CPUS}; // what get_way() searches; kept in step with block on fill and invalidation
   const uint32_t MAX_READ, MAX_WRITE;
   uint32_t reads_available_this_cycle, writes_available_this_cycle;
   const bool prefetch_as_load;
   const bool match_offset_bits;
   const bool virtual_prefetch;
   bool ever_seen_data = false;
+  bool in_front_of_memory = false; // misses go to DRAM; set by the simulator before the replacement policy is initialized
   const unsigned pref_activate_mask = (1 << static_cast<int>(LOAD)) | (1 << static_cast<int>(PREFETCH));
 
   // prefetch stats
@@ -68,6 +80,24 @@ public:
 
   uint64_t total_miss_latency = 0;
 
+  // every access handled by this cache, when the config names a capture file;
+  // the simulator opens it once the run starts
+  const std::string capture_file;
+  std::unique_ptr<champsim::access_stream::writer> capture;
+
+  // LRU stack distances of the accesses to this cache, when the config names
+  // a sampling rate; the simulator creates the profiler once the run starts
+  const double stack_distance_rate;
+  std::unique_ptr<champsim::stack_distance_profiler> stack_distance;
+
+  // whether the EbIS-aware replacement policies keep their eviction history
+  // in per-cpu Bloom filters (eviction_filter.h) instead of the exact EbIS
+  const bool ebis_filter;
+
+  // whether the EbIS-aware replacement policies insert prefetches at distant
+  // positions, promote them only on demand hits, and duel them separately
+  const bool prefetch_aware_repl;
+
   // functions
   int add_rq(PACKET* packet) override;
   int add_wq(PACKET* packet) override;
@@ -99,6 +129,8 @@ public:
   void readlike_hit(std::size_t set, std::size_t way, PACKET& handle_pkt);
   bool readlike_miss(PACKET& handle_pkt);
   bool filllike_miss(std::size_t set, std::size_t way, PACKET& handle_pkt);
+  void record_access(const PACKET& handle_pkt, bool hit, bool fill);
+  void functional_access(const champsim::access_stream::access& acc);
 
   bool should_activate_prefetcher(int type);
 
@@ -106,17 +138,43 @@ public:
 
 #include "cache_modules.inc"
 
+  // per-instance replacement policy state, created by the module in
+  // initialize_replacement() and reached directly on every access
+  std::shared_ptr<void> repl_state;
+
+  template <typename T, typename... Args>
+  T& make_replacement_state(Args&&... args)
+  {
+    auto state = std::make_shared<T>(std::forward<Args>(args)...);
+    repl_state = state;
+    return *state;
+  }
+
+  template <typename T>
+  T& get_replacement_state()
+  {
+    return *static_cast<T*>(repl_state.get());
+  }
+
   const repl_t repl_type;
   const pref_t pref_type;
 
+  // extra policies evaluated on copies of this cache, each with its module
+  // name; the simulator creates the copies once the run starts
+  const std::vector<std::pair<repl_t, std::string>> shadow_repl;
+  std::shared_ptr<champsim::shadow_group> shadows;
+
   // constructor
   CACHE(std::string v1, double freq_scale, unsigned fill_level, uint32_t v2, int v3, uint32_t v5, uint32_t v6, uint32_t v7, uint32_t v8, uint32_t hit_lat,
         uint32_t fill_lat, uint32_t max_read, uint32_t max_write, std::size_t offset_bits, bool pref_load, bool wq_full_addr, bool va_pref,
-        unsigned pref_act_mask, MemoryRequestConsumer* ll, pref_t pref, repl_t repl)
+        unsigned pref_act_mask, MemoryRequestConsumer* ll, pref_t pref, repl_t repl, std::string capture_file = "",
+        std::vector<std::pair<repl_t, std::string>> shadow_repl = {}, double stack_distance_rate = 0, bool ebis_filter = false,
+        bool prefetch_aware_repl = false)
       : champsim::operable(freq_scale), MemoryRequestConsumer(fill_level), MemoryRequestProducer(ll), NAME(v1), NUM_SET(v2), NUM_WAY(v3), WQ_SIZE(v5),
         RQ_SIZE(v6), PQ_SIZE(v7), MSHR_SIZE(v8), HIT_LATENCY(hit_lat), FILL_LATENCY(fill_lat), OFFSET_BITS(offset_bits), MAX_READ(max_read),
         MAX_WRITE(max_write), prefetch_as_load(pref_load), match_offset_bits(wq_full_addr), virtual_prefetch(va_pref), pref_activate_mask(pref_act_mask),
-        repl_type(repl), pref_type(pref)
+        capture_file(capture_file), stack_distance_rate(stack_distance_rate), ebis_filter(ebis_filter), prefetch_aware_repl(prefetch_aware_repl),
+        repl_type(repl), pref_type(pref), shadow_repl(shadow_repl)
   {
   }
 };
@@ -0,0 +1,49 @@
+#ifndef COMPACT_TRACE_H
+#define COMPACT_TRACE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "trace_instruction.h"
+
+namespace champsim::compact_trace
+{
+
+/***
+ * A compact encoding of input_instr traces (.cst files).
+ *
+ * The file starts with MAGIC, followed by blocks of up to BLOCK_RECORDS
+ * instructions. Each block is a block_header and the encoded instructions,
+ * and can be decoded without any other block. Each instruction is
+ *
+ *   - a flags byte: is_branch, branch_taken, and which of the 2 destination
+ *     and 4 source memory operands are present
+ *   - a byte saying which of the 2 destination and 4 source registers are
+ *     present
+ *   - the IP, as a zigzag varint of the difference from the previous IP
+ *   - the present registers, one byte each
+ *   - the present memory operands, each a zigzag varint of the difference
+ *     from the previous memory operand
+ *
+ * The previous IP and memory operand are 0 at the start of every block.
+ */
+constexpr char MAGIC[8] = {'C', 'H', 'A', 'M', 'P', 'C', 'S', 'T'};
+constexpr uint32_t BLOCK_RECORDS = 1 << 14;
+
+// the most one instruction can take
+constexpr std::size_t MAX_RECORD_BYTES = 2 + 10 + NUM_INSTR_DESTINATIONS + NUM_INSTR_SOURCES + 10 * (NUM_INSTR_DESTINATIONS + NUM_INSTR_SOURCES);
+
+struct block_header {
+  uint32_t records; // instructions in the block
+  uint32_t bytes;   // encoded bytes after the header
+};
+
+// append the encoded block, header included
+void encode_block(const input_instr* begin, const input_instr* end, std::vector<uint8_t>& out);
+
+// decode the block body described by the header; false if it is malformed
+bool decode_block(const block_header& header, const uint8_t* in, input_instr* out);
+
+} // namespace champsim::compact_trace
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef EBIS_H
+#define EBIS_H
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "champsim_constants.h"
+#include "util.h"
+
+namespace champsim
+{
+
+/***
+ * Evicted-block Inclusion Set shared by the EbIS-aware replacement policies.
+ *
+ * Entries live in a fixed pool of slots. Each slot is threaded onto a hash
+ * chain keyed on (set, full_addr) and onto an intrusive FIFO list for the
+ * application that owns it, so lookup, insertion and eviction never scan the
+ * whole set and never allocate.
+ *
+ * To evict from a full set:
+ * - for each application, 1) find the position of its oldest block 2) find its
+ *   total number of blocks
+ * - the one with the maximum difference of these two values is the target
+ * - remove the oldest block of the target application
+ * - insert the new block at the tail
+ *
+ * The position of each application's oldest block is maintained incrementally.
+ * Every slot remembers how many blocks each application had inserted before it,
+ * which together with the per-application removal counts gives the position of
+ * any slot in O(NUM_CPUS).
+ */
+class ebis
+{
+  using index_type = int32_t;
+  static constexpr index_type NIL = -1;
+
+  struct slot {
+    uint32_t cpu = 0;
+    uint32_t set = 0;
+    uint64_t full_addr = 0;
+    index_type hash_next = NIL;
+    index_type app_next = NIL;
+    std::array<uint64_t, NUM_CPUS> inserted_before = {};
+  };
+
+  struct app_list {
+    index_type head = NIL, tail = NIL;
+    uint64_t inserted = 0, removed = 0;
+    std::size_t first_pos = 0;
+
+    std::size_t count() const { return inserted - removed; }
+  };
+
+  std::vector<slot> slots;
+  std::vector<index_type> buckets;
+  std::array<app_list, NUM_CPUS> apps = {};
+  index_type free_head = NIL;
+  std::size_t occupancy = 0;
+
+  std::size_t bucket_of(uint32_t set, uint64_t full_addr) const
+  {
+    uint64_t key = (full_addr ^ (uint64_t{set} << 48)) * 0x9e3779b97f4a7c15ull;
+    return (key >> 32) & (std::size(buckets) - 1);
+  }
+
+  std::size_t position_of(index_type idx) const
+  {
+    std::size_t pos = 0;
+    for (std::size_t d = 0; d < NUM_CPUS; ++d)
+      if (slots[idx].inserted_before[d] > apps[d].removed)
+        pos += slots[idx].inserted_before[d] - apps[d].removed;
+    return pos;
+  }
+
+  uint32_t target_app() const
+  {
+    uint32_t victim_cpu = NUM_CPUS;
+    std::size_t target = 0;
+    for (uint32_t id = 0; id < NUM_CPUS; id++) {
+      std::size_t num_blocks = apps[id].count();
+      if (num_blocks > apps[id].first_pos && num_blocks - apps[id].first_pos > target) {
+        victim_cpu = id;
+        target = num_blocks - apps[id].first_pos;
+      }
+    }
+
+    // The application holding the oldest block always has a positive target
+    assert(victim_cpu < NUM_CPUS);
+    return victim_cpu;
+  }
+
+  void erase_oldest(uint32_t victim_cpu)
+  {
+    app_list& app = apps[victim_cpu];
+    index_type idx = app.head;
+    std::size_t pos = app.first_pos;
+
+    // unlink from the hash chain
+    index_type* link = &buckets[bucket_of(slots[idx].set, slots[idx].full_addr)];
+    while (*link != idx)
+      link = &slots[*link].hash_next;
+    *link = slots[idx].hash_next;
+
+    // unlink from the application list
+    app.head = slots[idx].app_next;
+    if (app.head == NIL)
+      app.tail = NIL;
+    app.removed++;
+
+    slots[idx].hash_next = free_head;
+    free_head = idx;
+    occupancy--;
+
+    // everything behind the removed block moves up one position
+    for (auto& other : apps)
+      if (&other != &app && other.count() > 0 && other.first_pos > pos)
+        other.first_pos--;
+
+    if (app.head != NIL)
+      app.first_pos = position_of(app.head);
+  }
+
+public:
+  explicit ebis(std::size_t capacity) : slots(capacity), buckets(std::size_t{1} << lg2(4 * capacity - 1), NIL)
+  {
+    for (std::size_t i = 0; i < capacity; ++i)
+      slots[i].hash_next = (i + 1 < capacity) ? static_cast<index_type>(i + 1) : NIL;
+    free_head = capacity > 0 ? 0 : NIL;
+  }
+
+  std::size_t size() const { return occupancy; }
+  std::size_t capacity() const { return std::size(slots); }
+  std::size_t count(uint32_t cpu) const { return apps[cpu].count(); }
+
+  bool contains(uint32_t set, uint64_t full_addr) const
+  {
+    for (index_type idx = buckets[bucket_of(set, full_addr)]; idx != NIL; idx = slots[idx].hash_next)
+      if (slots[idx].set == set && slots[idx].full_addr == full_addr)
+        return true;
+    return false;
+  }
+
+  /*
+   * Record an evicted block. If the set is full, the oldest block of the
+   * target application is removed first and its cpu is returned. Otherwise,
+   * returns NUM_CPUS.
+   */
+  uint32_t insert(uint32_t cpu, uint32_t set, uint64_t full_addr)
+  {
+    uint32_t victim_cpu = NUM_CPUS;
+    if (occupancy == capacity()) {
+      victim_cpu = target_app();
+      erase_oldest(victim_cpu);
+    }
+
+    index_type idx = free_head;
+    free_head = slots[idx].hash_next;
+
+    slot& s = slots[idx];
+    s.cpu = cpu;
+    s.set = set;
+    s.full_addr = full_addr;
+    for (std::size_t d = 0; d < NUM_CPUS; ++d)
+      s.inserted_before[d] = apps[d].inserted;
+
+    std::size_t bucket = bucket_of(set, full_addr);
+    s.hash_next = buckets[bucket];
+    buckets[bucket] = idx;
+
+    app_list& app = apps[cpu];
+    s.app_next = NIL;
+    if (app.tail == NIL) {
+      app.head = idx;
+      app.first_pos = occupancy;
+    } else {
+      slots[app.tail].app_next = idx;
+    }
+    app.tail = idx;
+    app.inserted++;
+    occupancy++;
+
+    return victim_cpu;
+  }
+};
+
+} // namespace champsim
+
+#endif
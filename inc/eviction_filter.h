@@ -0,0 +1,118 @@
+#ifndef EVICTION_FILTER_H
+#define EVICTION_FILTER_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "champsim_constants.h"
+#include "util.h"
+
+namespace champsim
+{
+
+/***
+ * Evicted-address filter: an approximate alternative to the EbIS.
+ *
+ * Every application has a counting Bloom filter of 4-bit counters that
+ * remembers the last `capacity` blocks it had evicted, typically as many as
+ * the cache holds. Once that many have been inserted the filter is cleared and
+ * starts over. As with the EbIS, a block is recalled whichever application
+ * evicted it: recall() looks in every filter. A block found in a filter is
+ * removed from it, so a block is only recalled once per eviction.
+ *
+ * Each filter has at least COUNTERS_PER_BLOCK counters per remembered block,
+ * rounded up to a power of two. Insertions touch NUM_HASHES counters, and
+ * lookups NUM_HASHES in each application's filter, regardless of the
+ * capacity. False positives are possible, at a rate of a few percent per
+ * filter when it is full.
+ */
+class eviction_filter
+{
+  static constexpr unsigned NUM_HASHES = 3;
+  static constexpr unsigned COUNTERS_PER_BLOCK = 8;
+  static constexpr uint8_t COUNTER_MAX = 0xf;
+
+  struct filter {
+    std::vector<uint8_t> nibbles;
+    std::size_t inserted = 0;
+    uint64_t clears = 0;
+  };
+
+  const std::size_t capacity_;
+  const uint64_t mask;
+  std::array<filter, NUM_CPUS> filters;
+
+  // double hashing over the counters
+  template <typename F>
+  void for_each_counter(uint64_t block, F&& f) const
+  {
+    uint64_t h1 = block * 0x9e3779b97f4a7c15ull;
+    uint64_t h2 = ((block ^ (block >> 29)) * 0xbf58476d1ce4e5b9ull) | 1;
+    for (unsigned i = 0; i < NUM_HASHES; ++i)
+      f(((h1 >> 20) + i * (h2 >> 20)) & mask);
+  }
+
+  static uint8_t get(const filter& fil, uint64_t idx) { return (fil.nibbles[idx / 2] >> (4 * (idx % 2))) & 0xf; }
+  static uint8_t step(uint64_t idx) { return static_cast<uint8_t>(1u << (4 * (idx % 2))); }
+
+public:
+  explicit eviction_filter(std::size_t capacity) : capacity_(capacity), mask((uint64_t{1} << (lg2(COUNTERS_PER_BLOCK * capacity - 1) + 1)) - 1)
+  {
+    for (auto& fil : filters)
+      fil.nibbles.resize((mask + 1) / 2);
+  }
+
+  std::size_t capacity() const { return capacity_; }
+  uint64_t clears(uint32_t cpu) const { return filters[cpu].clears; }
+
+  /*
+   * Whether any application evicted this block recently. If so, the first
+   * filter it is found in forgets it.
+   */
+  bool recall(uint64_t block)
+  {
+    for (filter& fil : filters) {
+      bool found = true;
+      for_each_counter(block, [&](uint64_t idx) { found = found && get(fil, idx) > 0; });
+      if (!found)
+        continue;
+
+      // saturated counters have lost count, and stay until the next clear
+      for_each_counter(block, [&](uint64_t idx) {
+        if (get(fil, idx) < COUNTER_MAX)
+          fil.nibbles[idx / 2] -= step(idx);
+      });
+      return true;
+    }
+    return false;
+  }
+
+  /*
+   * Record a block evicted by cpu, clearing its filter first if it is full.
+   * Returns whether the filter was cleared.
+   */
+  bool insert(uint32_t cpu, uint64_t block)
+  {
+    filter& fil = filters[cpu];
+    bool cleared = false;
+    if (fil.inserted == capacity_) {
+      std::fill(std::begin(fil.nibbles), std::end(fil.nibbles), 0);
+      fil.inserted = 0;
+      fil.clears++;
+      cleared = true;
+    }
+
+    for_each_counter(block, [&](uint64_t idx) {
+      if (get(fil, idx) < COUNTER_MAX)
+        fil.nibbles[idx / 2] += step(idx);
+    });
+    fil.inserted++;
+    return cleared;
+  }
+};
+
+} // namespace champsim
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef MAPPED_TRACE_H
+#define MAPPED_TRACE_H
+
+#include <cstdint>
+#include <string>
+
+namespace champsim
+{
+
+/***
+ * An uncompressed copy of a trace, mapped into memory.
+ *
+ * The first time a trace is used with a cache directory, it is decompressed
+ * into a file of fixed-size records there, named after a hash of the
+ * compressed file's contents and the record size. Later runs map that file
+ * read-only with MADV_SEQUENTIAL, so records are read straight out of the
+ * page cache and starting the trace over is a pointer reset.
+ */
+class mapped_trace
+{
+  const uint8_t* base = nullptr;
+  std::size_t length = 0;
+
+public:
+  mapped_trace(std::string path, std::size_t record_size, std::string cache_dir);
+  ~mapped_trace();
+
+  mapped_trace(const mapped_trace&) = delete;
+  mapped_trace& operator=(const mapped_trace&) = delete;
+
+  const uint8_t* begin() const { return base; }
+  const uint8_t* end() const { return base + length; }
+};
+
+} // namespace champsim
+
+#endif
@@ -37,13 +37,7 @@ public:
   bool valid = false, prefetch = false, dirty = false;
 
   uint64_t address = 0, v_address = 0, tag = 0, data = 0, ip = 0, cpu = 0,
-           instr_id = 0;
-
-  // replacement state
-  uint32_t lru = std::numeric_limits<uint32_t>::max() >> 1;
-
-  // additional replacement state for rrpv
-  uint32_t rrpv = std::numeric_limits<uint32_t>::max() >> 1;
+           instr_id = 0, fill_cycle = 0;
 };
 
 class MemoryRequestConsumer {
@@ -0,0 +1,211 @@
+#ifndef PACKED_WAYS_H
+#define PACKED_WAYS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace champsim
+{
+
+/***
+ * One byte of replacement state per way, kept apart from BLOCK.
+ *
+ * Each set is padded to a multiple of 16 bytes, so a 16-way set is a single
+ * SSE2 vector and the kernels below touch it with one load and at most one
+ * store. Operations can be restricted to a subset of the ways with a bitmask
+ * (bit i selects way i), which is how per-application variants are expressed.
+ * Padding bytes are never selected. A scalar fallback is used when SSE2 is not
+ * available.
+ *
+ * The same layout holds LRU stack positions. There, OLDEST stands for a
+ * position older than anything representable: ways that have never been
+ * touched start there, ages saturate there, and demote() leaves them alone.
+ * Real positions stay far below it for any set of up to 64 ways.
+ *
+ * This reproduces the old 32-bit BLOCK::lru counters victim for victim. Those
+ * started every way at UINT32_MAX >> 1, so never-touched ways also tied with
+ * each other above every touched way, and max_element broke ties by taking
+ * the first maximum, as oldest() does. The counters only differ in value, and
+ * only for never-touched ways. Those are never valid, and the cache fills
+ * invalid ways before it asks for a victim.
+ */
+class packed_ways
+{
+public:
+  using mask_type = uint64_t;
+  static constexpr uint8_t OLDEST = 0xff;
+
+private:
+  static constexpr std::size_t CHUNK = 16;
+
+  std::size_t num_way, stride;
+  std::vector<uint8_t> bytes;
+
+  uint8_t* set_begin(std::size_t set) { return bytes.data() + set * stride; }
+  const uint8_t* set_begin(std::size_t set) const { return bytes.data() + set * stride; }
+
+#ifdef __SSE2__
+  // a byte of 0xff for every way of the chunk selected by the 16-bit mask
+  static __m128i expand(unsigned bits)
+  {
+    const __m128i select = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i spread = _mm_unpacklo_epi64(_mm_set1_epi8(static_cast<char>(bits & 0xff)), _mm_set1_epi8(static_cast<char>(bits >> 8)));
+    return _mm_cmpeq_epi8(_mm_and_si128(spread, select), select);
+  }
+
+  static uint8_t horizontal_max(__m128i v)
+  {
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 4));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 2));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 1));
+    return static_cast<uint8_t>(_mm_cvtsi128_si32(v));
+  }
+#endif
+
+  static unsigned chunk_bits(mask_type ways, std::size_t chunk) { return static_cast<unsigned>((ways >> (chunk * CHUNK)) & 0xffff); }
+
+  static uint32_t first_way(mask_type hits) { return static_cast<uint32_t>(__builtin_ctzll(hits)); }
+
+public:
+  packed_ways(std::size_t num_set, std::size_t num_way, uint8_t init) : num_way(num_way), stride((num_way + CHUNK - 1) / CHUNK * CHUNK), bytes(num_set * stride, 0)
+  {
+    assert(num_way <= 8 * sizeof(mask_type));
+    for (std::size_t set = 0; set < num_set; ++set)
+      std::fill_n(set_begin(set), num_way, init);
+  }
+
+  uint8_t& operator()(std::size_t set, std::size_t way) { return set_begin(set)[way]; }
+  uint8_t operator()(std::size_t set, std::size_t way) const { return set_begin(set)[way]; }
+
+  mask_type all_ways() const { return num_way == 8 * sizeof(mask_type) ? ~mask_type{0} : (mask_type{1} << num_way) - 1; }
+
+  // the selected ways whose byte equals val
+  mask_type equal(std::size_t set, uint8_t val, mask_type ways) const
+  {
+    mask_type hits = 0;
+#ifdef __SSE2__
+    const __m128i target = _mm_set1_epi8(static_cast<char>(val));
+    for (std::size_t chunk = 0; chunk * CHUNK < num_way; ++chunk) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set_begin(set) + chunk * CHUNK));
+      hits |= mask_type{static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, target)))} << (chunk * CHUNK);
+    }
+#else
+    for (std::size_t way = 0; way < num_way; ++way)
+      hits |= mask_type{set_begin(set)[way] == val} << way;
+#endif
+    return hits & ways;
+  }
+
+  // first selected way whose byte equals val, or NUM_WAY
+  uint32_t find(std::size_t set, uint8_t val, mask_type ways) const
+  {
+    mask_type hits = equal(set, val, ways);
+    return hits == 0 ? static_cast<uint32_t>(num_way) : first_way(hits);
+  }
+
+  // largest byte among the selected ways, which must not be empty
+  uint8_t max(std::size_t set, mask_type ways) const
+  {
+    assert(ways != 0);
+    uint8_t result = 0;
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    for (std::size_t chunk = 0; chunk * CHUNK < num_way; ++chunk) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set_begin(set) + chunk * CHUNK));
+      acc = _mm_max_epu8(acc, _mm_and_si128(v, expand(chunk_bits(ways, chunk))));
+    }
+    result = horizontal_max(acc);
+#else
+    for (std::size_t way = 0; way < num_way; ++way)
+      if ((ways >> way) & 1)
+        result = std::max(result, set_begin(set)[way]);
+#endif
+    return result;
+  }
+
+  // first selected way holding the largest byte; ties go to the lowest way, like std::max_element
+  uint32_t oldest(std::size_t set, mask_type ways) const { return first_way(equal(set, max(set, ways), ways)); }
+
+  // move `way` to the MRU position; every way at or below its old position ages by one
+  void promote(std::size_t set, std::size_t way)
+  {
+    const uint8_t pos = set_begin(set)[way];
+#ifdef __SSE2__
+    const __m128i hit = _mm_set1_epi8(static_cast<char>(pos));
+    const __m128i one = _mm_set1_epi8(1);
+    for (std::size_t chunk = 0; chunk * CHUNK < num_way; ++chunk) {
+      auto addr = reinterpret_cast<__m128i*>(set_begin(set) + chunk * CHUNK);
+      __m128i v = _mm_loadu_si128(addr);
+      __m128i younger = _mm_and_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, hit), v), expand(chunk_bits(all_ways(), chunk)));
+      _mm_storeu_si128(addr, _mm_adds_epu8(v, _mm_and_si128(younger, one)));
+    }
+#else
+    for (std::size_t i = 0; i < num_way; ++i)
+      if (set_begin(set)[i] <= pos && set_begin(set)[i] != OLDEST)
+        set_begin(set)[i]++;
+#endif
+    set_begin(set)[way] = 0;
+  }
+
+  // move `way` to position `bottom`; every way at or above its old position, other than OLDEST ones, gets one younger
+  void demote(std::size_t set, std::size_t way, uint8_t bottom)
+  {
+    const uint8_t pos = set_begin(set)[way];
+#ifdef __SSE2__
+    const __m128i hit = _mm_set1_epi8(static_cast<char>(pos));
+    const __m128i oldest = _mm_set1_epi8(static_cast<char>(OLDEST));
+    for (std::size_t chunk = 0; chunk * CHUNK < num_way; ++chunk) {
+      auto addr = reinterpret_cast<__m128i*>(set_begin(set) + chunk * CHUNK);
+      __m128i v = _mm_loadu_si128(addr);
+      __m128i older = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, hit), v), expand(chunk_bits(all_ways(), chunk)));
+      _mm_storeu_si128(addr, _mm_add_epi8(v, _mm_andnot_si128(_mm_cmpeq_epi8(v, oldest), older))); // add -1 to each selected lane
+    }
+#else
+    for (std::size_t i = 0; i < num_way; ++i)
+      if (set_begin(set)[i] >= pos && set_begin(set)[i] != OLDEST)
+        set_begin(set)[i]--;
+#endif
+    set_begin(set)[way] = bottom;
+  }
+
+  /*
+   * RRIP victim search. Returns the first selected way holding the largest
+   * byte and ages the selected ways so that this byte becomes `ceiling`. This
+   * is what repeatedly incrementing the selected ways until one of them reaches
+   * `ceiling` would do, provided none is above it to begin with.
+   */
+  uint32_t age_to(std::size_t set, uint8_t ceiling, mask_type ways)
+  {
+    uint8_t oldest = max(set, ways);
+    uint8_t delta = oldest < ceiling ? ceiling - oldest : 0;
+    mask_type hits = 0;
+#ifdef __SSE2__
+    const __m128i inc = _mm_set1_epi8(static_cast<char>(delta));
+    const __m128i target = _mm_set1_epi8(static_cast<char>(oldest + delta));
+    for (std::size_t chunk = 0; chunk * CHUNK < num_way; ++chunk) {
+      auto addr = reinterpret_cast<__m128i*>(set_begin(set) + chunk * CHUNK);
+      __m128i v = _mm_add_epi8(_mm_loadu_si128(addr), _mm_and_si128(inc, expand(chunk_bits(ways, chunk))));
+      _mm_storeu_si128(addr, v);
+      hits |= mask_type{static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, target)))} << (chunk * CHUNK);
+    }
+#else
+    for (std::size_t way = 0; way < num_way; ++way) {
+      if ((ways >> way) & 1)
+        set_begin(set)[way] += delta;
+      hits |= mask_type{set_begin(set)[way] == oldest + delta} << way;
+    }
+#endif
+    return first_way(hits & ways);
+  }
+};
+
+} // namespace champsim
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef SET_DUELING_H
+#define SET_DUELING_H
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+#include "champsim_constants.h"
+#include "set_roles.h"
+
+namespace champsim
+{
+
+/***
+ * Per-cpu set dueling among N candidate policies.
+ *
+ * Every cpu owns SDM_SIZE leader sets per candidate. Leader sets always run
+ * their own candidate and train that cpu's selector on a miss; every other set
+ * follows the candidate the selector currently favours.
+ *
+ * With two candidates the selector is the classic PSEL counter: misses in
+ * candidate 0's leaders count it down, misses in candidate 1's leaders count it
+ * up, and followers run candidate 0 once it is above half range. With more
+ * candidates each one gets a saturating miss counter (all counters are halved
+ * when one saturates) and followers run the candidate with the fewest misses.
+ * The favoured candidate is cached per cpu and only recomputed when a leader
+ * misses, so followers never pay more than a load.
+ */
+template <std::size_t N, std::size_t SDM_SIZE = 32, unsigned SELECTOR_WIDTH = 10>
+class set_dueling
+{
+  static_assert(N >= 2 && N < 16, "leader roles keep the candidate in the lower nibble");
+
+  set_role_table<> roles;
+  std::array<std::array<unsigned, N == 2 ? 1 : N>, NUM_CPUS> selector = {};
+  std::array<uint8_t, NUM_CPUS> favoured = {};
+
+  void train(std::size_t cpu, std::size_t leader)
+  {
+    auto& sel = selector[cpu];
+    if constexpr (N == 2) {
+      if (leader == 0 && sel[0] > 0)
+        sel[0]--;
+      if (leader == 1 && sel[0] < SELECTOR_MAX)
+        sel[0]++;
+      favoured[cpu] = sel[0] > SELECTOR_MAX / 2 ? 0 : 1;
+    } else {
+      if (sel[leader] == SELECTOR_MAX)
+        for (auto& count : sel)
+          count /= 2;
+      sel[leader]++;
+
+      // ties keep the current choice
+      for (std::size_t k = 0; k < N; ++k)
+        if (sel[k] < sel[favoured[cpu]])
+          favoured[cpu] = static_cast<uint8_t>(k);
+    }
+  }
+
+public:
+  static constexpr std::size_t NUM_POLICY = N;
+  static constexpr std::size_t TOTAL_SDM_SETS = NUM_CPUS * N * SDM_SIZE;
+  static constexpr unsigned SELECTOR_MAX = (1u << SELECTOR_WIDTH) - 1;
+
+  explicit set_dueling(std::size_t num_set)
+      : roles(num_set, TOTAL_SDM_SETS, [](std::size_t rank) { return dueling_role::leader(rank / (N * SDM_SIZE), rank % N); })
+  {
+    favoured.fill(N - 1);
+  }
+
+  // the candidate this cpu runs in this set
+  std::size_t policy(uint32_t cpu, uint32_t set) const
+  {
+    auto leader = dueling_role::leader_policy(roles[set], cpu);
+    return leader == dueling_role::NOT_LEADER ? favoured[cpu] : leader;
+  }
+
+  // train the selector if the set is one of this cpu's leaders, then pick the candidate to run
+  std::size_t on_miss(uint32_t cpu, uint32_t set)
+  {
+    auto leader = dueling_role::leader_policy(roles[set], cpu);
+    if (leader == dueling_role::NOT_LEADER)
+      return favoured[cpu];
+
+    train(cpu, leader);
+    return leader;
+  }
+
+  /*
+   * Same as on_miss(cpu, set), but also runs the chosen candidate. The
+   * candidates are passed in order as callables taking no arguments; the
+   * result of the one that ran is returned.
+   */
+  template <typename... Fs>
+  decltype(auto) on_miss(uint32_t cpu, uint32_t set, Fs&&... candidates)
+  {
+    static_assert(sizeof...(Fs) == N, "one callable per candidate policy");
+    return run(on_miss(cpu, set), std::forward<Fs>(candidates)...);
+  }
+
+  template <typename... Fs>
+  static auto run(std::size_t k, Fs&&... candidates)
+  {
+    using result_type = std::common_type_t<std::invoke_result_t<Fs&>...>;
+    std::size_t i = 0;
+    if constexpr (std::is_void_v<result_type>) {
+      (void)((i++ == k ? (candidates(), true) : false) || ...);
+    } else {
+      result_type result{};
+      (void)((i++ == k ? (result = candidates(), true) : false) || ...);
+      return result;
+    }
+  }
+};
+
+} // namespace champsim
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef SET_ROLES_H
+#define SET_ROLES_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "champsim_constants.h"
+
+namespace champsim
+{
+
+/*
+ * Draw `count` distinct sets out of `num_set`, in ascending order.
+ * This is the pseudo-random sequence the dueling and sampling policies have
+ * always used, so the chosen sets do not change.
+ */
+inline std::vector<std::size_t> sample_sets(std::size_t num_set, std::size_t count)
+{
+  std::vector<std::size_t> sets;
+  std::size_t rand_seed = 1103515245 + 12345;
+  for (std::size_t i = 0; i < count; i++) {
+    std::size_t val = (rand_seed / 65536) % num_set;
+    auto loc = std::lower_bound(std::begin(sets), std::end(sets), val);
+
+    while (loc != std::end(sets) && *loc == val) {
+      rand_seed = rand_seed * 1103515245 + 12345;
+      val = (rand_seed / 65536) % num_set;
+      loc = std::lower_bound(std::begin(sets), std::end(sets), val);
+    }
+
+    sets.insert(loc, val);
+  }
+
+  return sets;
+}
+
+/***
+ * Role of every set in a cache, built once at initialization.
+ *
+ * The sets returned by sample_sets() are tagged with a role chosen by the
+ * policy from their rank among the sampled sets; every other set keeps the
+ * default role. Classifying a set on the access path is a single load instead
+ * of a search through the sampled sets.
+ */
+template <typename T = uint8_t>
+class set_role_table
+{
+  std::vector<T> roles;
+
+public:
+  template <typename F>
+  set_role_table(std::size_t num_set, std::size_t num_sampled, F&& role_of_rank, T default_role = T{}) : roles(num_set, default_role)
+  {
+    auto sampled = sample_sets(num_set, num_sampled);
+    for (std::size_t rank = 0; rank < std::size(sampled); ++rank)
+      roles[sampled[rank]] = role_of_rank(rank);
+  }
+
+  T operator[](std::size_t set) const { return roles[set]; }
+};
+
+/*
+ * Byte-sized roles for set dueling. A leader set belongs to one cpu and one
+ * candidate policy; for every other cpu it is a follower.
+ */
+namespace dueling_role
+{
+constexpr uint8_t FOLLOWER = 0;
+constexpr std::size_t NOT_LEADER = ~std::size_t{0};
+
+static_assert(NUM_CPUS < 16, "leader roles keep the cpu in the upper nibble");
+
+constexpr uint8_t leader(std::size_t cpu, std::size_t policy) { return static_cast<uint8_t>(((cpu + 1) << 4) | policy); }
+
+// the policy a leader set runs for this cpu, or NOT_LEADER
+constexpr std::size_t leader_policy(uint8_t role, std::size_t cpu) { return (role >> 4) == cpu + 1 ? (role & 0xf) : NOT_LEADER; }
+} // namespace dueling_role
+
+} // namespace champsim
+
+#endif
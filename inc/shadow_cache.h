@@ -0,0 +1,77 @@
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "access_stream.h"
+#include "cache.h"
+
+namespace champsim
+{
+
+/***
+ * Functional copies of a cache, one per extra replacement policy named in its
+ * "shadow_replacement" config, that see the same accesses as the cache itself.
+ *
+ * Each copy has the geometry of its owner and runs its policy through the
+ * usual module hooks, but fills on every miss at once and never touches the
+ * rest of the system, so only the owner's policy affects timing. Accesses are
+ * gathered into batches that every copy replays on its own worker thread; the
+ * simulation only waits if a worker falls several batches behind.
+ *
+ * The copies' statistics may only be read or reset after sync().
+ */
+class shadow_group
+{
+  static constexpr std::size_t BATCH_SIZE = 1 << 14;
+  static constexpr std::size_t MAX_PENDING = 8;
+
+  using batch = std::vector<access_stream::access>;
+
+  struct shadow {
+    CACHE cache;
+    std::deque<std::shared_ptr<const batch>> pending;
+    bool busy = false;
+    std::thread worker;
+
+    shadow(const CACHE& owner, CACHE::repl_t repl, const std::string& repl_name);
+  };
+
+  std::vector<std::unique_ptr<shadow>> shadows;
+  batch current;
+
+  std::mutex mtx;
+  std::condition_variable have_work, have_room;
+  bool closing = false;
+
+  void flush_batch();
+  void run(shadow& s);
+
+public:
+  explicit shadow_group(const CACHE& owner);
+  shadow_group(const shadow_group&) = delete;
+  shadow_group& operator=(const shadow_group&) = delete;
+  ~shadow_group();
+
+  void push(const access_stream::access& acc)
+  {
+    current.push_back(acc);
+    if (current.size() == BATCH_SIZE)
+      flush_batch();
+  }
+
+  // hand over the partial batch and wait until every copy has replayed it
+  void sync();
+
+  std::vector<CACHE*> caches() const;
+};
+
+} // namespace champsim
+
+#endif
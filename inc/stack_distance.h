@@ -0,0 +1,96 @@
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "champsim_constants.h"
+#include "set_roles.h"
+
+namespace champsim
+{
+
+/***
+ * LRU stack distances of one access stream, from which the miss ratio of an
+ * LRU cache of any size can be read.
+ *
+ * Fully associative distances count the distinct blocks touched since the last
+ * access to the same block. Every block marks the time of its last access in a
+ * Fenwick tree, so the count is a prefix sum; when the timeline fills up, the
+ * live marks are renumbered in order. Distances land in power-of-two buckets,
+ * which are exact for power-of-two capacities.
+ *
+ * Per-set distances, for caches with this many sets but other associativities,
+ * are kept for the sampled sets only, each in a short move-to-front stack.
+ */
+class stack_distance_profile
+{
+public:
+  static constexpr std::size_t NUM_BUCKETS = 65;
+
+private:
+  // Fenwick tree over the timeline of last accesses
+  std::vector<int32_t> tree;
+  std::unordered_map<uint64_t, uint64_t> last_access;
+  uint64_t now = 0;
+
+  // MRU-first stacks of the sampled sets, `depth` blocks each
+  const std::size_t depth;
+  std::vector<uint64_t> set_stacks;
+  std::vector<uint32_t> set_used;
+
+  void mark(uint64_t time, int32_t delta);
+  uint64_t marked_after(uint64_t time) const;
+  void compact();
+
+public:
+  // fully associative: accesses by bucket of scaled distance, then cold misses
+  std::array<uint64_t, NUM_BUCKETS> capacity_hist = {};
+  uint64_t capacity_cold = 0, capacity_accesses = 0;
+
+  // per set: accesses by stack position, then deeper or cold
+  std::vector<uint64_t> way_hist;
+  uint64_t way_accesses = 0;
+
+  stack_distance_profile(std::size_t num_sampled_sets, std::size_t depth);
+
+  void access_block(uint64_t block, double scale);
+  void access_set(std::size_t stack, uint64_t block);
+  void reset_stats();
+
+  double capacity_miss_ratio(uint64_t blocks) const;
+  double way_miss_ratio(std::size_t ways) const;
+};
+
+/***
+ * Stack distance profiles of a cache, for each cpu and for all of them
+ * together. Accesses are sampled SHARDS-style: a block is profiled when a hash
+ * of its address falls below the sampling rate, and its distances are scaled
+ * up by the inverse of the rate. Per-set profiles sample whole sets instead, at
+ * the same rate, so their distances need no scaling.
+ */
+class stack_distance_profiler
+{
+  static constexpr uint64_t HASH_RANGE = 1 << 24;
+
+  const std::size_t num_set, num_way;
+  const double rate;
+  const uint64_t threshold;
+  set_role_table<uint32_t> set_rank; // one past the rank of a sampled set, or 0
+
+  std::vector<stack_distance_profile> profiles; // one per cpu, then one for all of them
+
+public:
+  stack_distance_profiler(std::size_t num_set, std::size_t num_way, double rate);
+
+  void access(uint32_t cpu, uint64_t block, std::size_t set);
+  void reset_stats();
+  void print(const std::string& name) const;
+};
+
+} // namespace champsim
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef TAG_ARRAY_H
+#define TAG_ARRAY_H
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace champsim
+{
+
+/***
+ * Tags and valid bits of a cache, kept apart from the rest of BLOCK.
+ *
+ * Each set is a dense run of 64-bit tags (padded to a whole number of SSE2
+ * vectors) plus one word of valid bits, so a 16-way lookup reads two cache
+ * lines of tags and compares them two at a time. The cache updates this
+ * array on fill and invalidation; everything else about a block stays in
+ * BLOCK and is only touched once the way is known. A scalar fallback is used
+ * when SSE2 is not available.
+ *
+ * The array also knows which cpu filled each valid way: every set keeps one
+ * way mask per cpu, and the whole cache one block count per cpu, so owner
+ * queries are a load and a popcount rather than a walk over BLOCK.
+ */
+class tag_array
+{
+public:
+  using mask_type = uint64_t;
+
+private:
+  static constexpr std::size_t CHUNK = 2;
+
+  std::size_t num_way, stride, num_cpu;
+  std::vector<uint64_t> tags;
+  std::vector<mask_type> valid;
+  std::vector<mask_type> owned;  // num_cpu masks per set
+  std::vector<uint32_t> owner;   // per way, meaningful while the way is valid
+  std::vector<uint64_t> blocks_of; // per cpu
+
+  const uint64_t* set_begin(std::size_t set) const { return tags.data() + set * stride; }
+
+  mask_type all_ways() const { return num_way == 8 * sizeof(mask_type) ? ~mask_type{0} : (mask_type{1} << num_way) - 1; }
+
+  static uint32_t first_way(mask_type hits) { return static_cast<uint32_t>(__builtin_ctzll(hits)); }
+
+public:
+  tag_array(std::size_t num_set, std::size_t num_way, std::size_t num_cpu = 1)
+      : num_way(num_way), stride((num_way + CHUNK - 1) / CHUNK * CHUNK), num_cpu(num_cpu), tags(num_set * stride), valid(num_set), owned(num_set * num_cpu),
+        owner(num_set * num_way), blocks_of(num_cpu)
+  {
+    assert(num_way <= 8 * sizeof(mask_type));
+  }
+
+  bool is_valid(std::size_t set, std::size_t way) const { return (valid[set] >> way) & 1; }
+
+  // first invalid way, or NUM_WAY if the set is full
+  uint32_t first_invalid(std::size_t set) const
+  {
+    mask_type free = ~valid[set] & all_ways();
+    return free == 0 ? static_cast<uint32_t>(num_way) : first_way(free);
+  }
+
+  // first valid way holding tag, or NUM_WAY
+  uint32_t find(std::size_t set, uint64_t tag) const
+  {
+    mask_type hits = 0;
+#ifdef __SSE2__
+    const __m128i target = _mm_set1_epi64x(static_cast<long long>(tag));
+    for (std::size_t chunk = 0; chunk * CHUNK < num_way; ++chunk) {
+      __m128i halves = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(set_begin(set) + chunk * CHUNK)), target);
+      __m128i eq = _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1))); // both halves of a tag must match
+      hits |= mask_type{static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(eq)))} << (chunk * CHUNK);
+    }
+#else
+    for (std::size_t way = 0; way < num_way; ++way)
+      hits |= mask_type{set_begin(set)[way] == tag} << way;
+#endif
+    hits &= valid[set];
+    return hits == 0 ? static_cast<uint32_t>(num_way) : first_way(hits);
+  }
+
+  // valid ways of the set filled by cpu
+  mask_type owned_ways(std::size_t set, std::size_t cpu) const { return owned[set * num_cpu + cpu]; }
+  uint32_t owned_count(std::size_t set, std::size_t cpu) const { return static_cast<uint32_t>(__builtin_popcountll(owned_ways(set, cpu))); }
+
+  // valid blocks filled by cpu, over the whole cache
+  uint64_t occupancy(std::size_t cpu) const { return blocks_of[cpu]; }
+
+  void fill(std::size_t set, std::size_t way, uint64_t tag, uint32_t cpu = 0)
+  {
+    invalidate(set, way);
+
+    tags[set * stride + way] = tag;
+    valid[set] |= mask_type{1} << way;
+    owner[set * num_way + way] = cpu;
+    owned[set * num_cpu + cpu] |= mask_type{1} << way;
+    blocks_of[cpu]++;
+  }
+
+  void invalidate(std::size_t set, std::size_t way)
+  {
+    if (!is_valid(set, way))
+      return;
+
+    uint32_t cpu = owner[set * num_way + way];
+    valid[set] &= ~(mask_type{1} << way);
+    owned[set * num_cpu + cpu] &= ~(mask_type{1} << way);
+    blocks_of[cpu]--;
+  }
+};
+
+} // namespace champsim
+
+#endif
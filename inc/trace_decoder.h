@@ -0,0 +1,88 @@
+#ifndef TRACE_DECODER_H
+#define TRACE_DECODER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace champsim
+{
+
+/***
+ * Decompresses a trace on a thread of its own, for one or more readers.
+ *
+ * The trace is read with liblzma (.xz), zlib (.gz) or the compact trace
+ * decoder (.cst, see compact_trace.h) in-process, from the file or, for http
+ * URLs, from the output of wget. Decoded bytes are handed out in
+ * numbered chunks of whole records. Each reader asks for chunks in order with
+ * its own cursor; the decoder keeps up to RING_SIZE chunks ready ahead of the
+ * furthest reader, and keeps chunks behind it until every reader has moved
+ * on, or until they are MAX_LAG chunks old. A reader that asks for a chunk
+ * that has been dropped gets nullptr and has to decode the trace on its own,
+ * with a decoder that skips to the records it has reached.
+ *
+ * Chunk boundaries depend only on the trace, the record size and the
+ * instructions skipped, so chunk i holds the same records in every decoder
+ * of the same trace.
+ *
+ * The first pass can start some instructions into the trace. The decoder
+ * seeks as close to them as the trace allows (the block index of a
+ * multi-block .xz, or the blocks of a .cst) and decodes the rest. At the end
+ * of the trace it marks the chunk and starts over from the very beginning,
+ * so readers see an endless stream of records.
+ */
+class trace_decoder
+{
+public:
+  static constexpr std::size_t RING_SIZE = 8;
+  static constexpr std::size_t MAX_LAG = 56;
+  static constexpr std::size_t CHUNK_BYTES = 1 << 20;
+
+  struct chunk {
+    std::unique_ptr<uint8_t[]> data;
+    std::size_t size = 0;     // bytes, a multiple of the record size
+    bool end_of_trace = false; // the last chunk of a pass through the trace
+  };
+
+private:
+  const std::string path;
+  const std::size_t record_size, capacity;
+  const uint64_t skip_instructions;
+
+  mutable std::mutex mutex;
+  std::condition_variable decoded, wanted;
+  std::deque<std::shared_ptr<chunk>> window; // chunks [first, first + window.size())
+  std::vector<std::unique_ptr<uint8_t[]>> spare;
+  std::vector<uint64_t> cursors;
+  uint64_t first = 0, furthest = 0;
+  bool stopping = false;
+  std::thread worker;
+
+  uint64_t produced() const { return first + window.size(); }
+  void run();
+
+public:
+  trace_decoder(std::string path, std::size_t record_size, uint64_t skip_instructions = 0);
+  ~trace_decoder();
+
+  trace_decoder(const trace_decoder&) = delete;
+  trace_decoder& operator=(const trace_decoder&) = delete;
+
+  // register a reader, starting at chunk 0
+  std::size_t attach();
+
+  // the reader no longer holds any chunk back
+  void detach(std::size_t reader);
+
+  // chunk number index, waiting for the decoder if need be; nullptr if it has been dropped
+  std::shared_ptr<const chunk> get(std::size_t reader, uint64_t index);
+};
+
+} // namespace champsim
+
+#endif
@@ -17,24 +17,41 @@
 #ifndef TRACEREADER_H
 #define TRACEREADER_H
 
-#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
 #include <string>
 
 #include "instruction.h"
+#include "mapped_trace.h"
+#include "trace_decoder.h"
 
 class tracereader
 {
 protected:
-  FILE* trace_file = NULL;
   uint8_t cpu;
-  std::string cmd_fmtstr;
-  std::string decomp_program;
   std::string trace_string;
+  const std::size_t record_size;
+  const std::string cache_dir;
+  const uint64_t skip_instructions; // where the first pass through the trace starts
+
+  // records come from the mapped cache file if there is one, else from the decoder's current chunk;
+  // readers of the same trace share both
+  std::shared_ptr<const champsim::mapped_trace> mapping;
+  std::shared_ptr<champsim::trace_decoder> decoder;
+  std::size_t reader = 0;
+  uint64_t chunk_index = 0;
+  uint64_t chunk_position = 0; // records before the current chunk in this pass through the trace
+  std::shared_ptr<const champsim::trace_decoder::chunk> current;
+  const uint8_t *next = nullptr, *end = nullptr;
+
+  void fetch_chunk();
+  void refill();
 
 public:
   tracereader(const tracereader& other) = delete;
-  tracereader(uint8_t cpu, std::string _ts);
-  ~tracereader();
+  tracereader(uint8_t cpu, std::string _ts, std::size_t record_size, std::string cache_dir, uint64_t skip_instructions);
+  virtual ~tracereader();
   void open(std::string trace_string);
   void close();
 
@@ -44,6 +61,21 @@ public:
   virtual ooo_model_instr get() = 0;
 };
 
-tracereader* get_tracereader(std::string fname, uint8_t cpu, bool is_cloudsuite);
+template <typename T>
+ooo_model_instr tracereader::read_single_instr()
+{
+  while (next == end)
+    refill();
+
+  T trace_read_instr;
+  std::memcpy(&trace_read_instr, next, sizeof(T));
+  next += sizeof(T);
+
+  // copy the instruction into the performance model's instruction format
+  ooo_model_instr retval(cpu, trace_read_instr);
+  return retval;
+}
+
+tracereader* get_tracereader(std::string fname, uint8_t cpu, bool is_cloudsuite, std::string cache_dir, uint64_t skip_instructions);
 
 #endif
@@ -1,11 +1,12 @@
 #include "cache.h"
+#include "ebis.h"
+#include "packed_ways.h"
 
 #include <algorithm>
+#include <array>
 #include <cstdio>
-#include <deque>
 #include <exception>
 #include <iterator>
-#include <map>
 
 #define maxRRPV 3
 
@@ -22,39 +23,38 @@ blocks
 * - remove first block of the target application
 * - insert new block at the head of ebis
 */
-struct ebis_entry_t {
-  uint32_t cpu;
-  uint32_t set;
-  uint64_t full_addr;
-};
-
+namespace {
 struct stat_entry_t {
-  uint64_t num_max_rrpv_same;
-  uint64_t num_max_rrpv_other;
-  uint64_t num_diff_rrpv_same;
-  std::map<uint32_t, uint64_t> ebis_evictions_per_app;
+  uint64_t num_max_rrpv_same = 0;
+  uint64_t num_max_rrpv_other = 0;
+  uint64_t num_diff_rrpv_same = 0;
+  std::array<uint64_t, NUM_CPUS> ebis_evictions_per_app = {};
 };
 
-std::map<CACHE *, stat_entry_t> stats;
+struct aarrip_state {
+  champsim::ebis ebis{EBIS_SIZE};
+  stat_entry_t stats;
+  champsim::packed_ways rrpv;
 
-std::map<CACHE *, std::deque<ebis_entry_t>> ebis;
-
-std::map<CACHE *, uint32_t> app_to_evict;
+  aarrip_state(std::size_t num_set, std::size_t num_way)
+      : rrpv(num_set, num_way, maxRRPV) {
+    // the EbIS starts out full of empty blocks owned by cpu0
+    while (ebis.size() < ebis.capacity())
+      ebis.insert(0, 0, 0);
+  }
+};
+} // namespace
 
 // initialize replacement state
 void CACHE::initialize_replacement() {
-  for (auto &blk : block)
-    blk.rrpv = maxRRPV;
-  ebis[this] = std::deque<ebis_entry_t>(EBIS_SIZE);
-  stats[this] = stat_entry_t{0, 0, 0};
-  app_to_evict[this] = 0;
+  make_replacement_state<aarrip_state>(NUM_SET, NUM_WAY);
 }
 
 // find replacement victim
 uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set,
                             const BLOCK *current_set, uint64_t ip,
                             uint64_t full_addr, uint32_t type) {
-  std::cout << "find_victim" << std::endl;
+  auto &state = get_replacement_state<aarrip_state>();
 
   /*
    * First look for the maxRRPV line
@@ -64,107 +64,36 @@ uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set,
    * of the same application and repeat the above steps
    * */
 
+  // ways held by this application
+  champsim::packed_ways::mask_type own = tags.owned_ways(set, cpu);
+
   // look for the maxRRPV line
-  auto begin = std::next(std::begin(block), set * NUM_WAY);
-  auto end = std::next(begin, NUM_WAY);
-  auto victim = std::find_if(begin, end, [cpu](BLOCK x) {
-    return x.rrpv == maxRRPV && x.cpu == cpu;
-  }); // hijack the lru field
-  if (victim != end) {
-    stats[this].num_max_rrpv_same++;
+  uint32_t way = state.rrpv.find(set, maxRRPV, own);
+  if (way != NUM_WAY) {
+    state.stats.num_max_rrpv_same++;
   }
-  uint32_t way;
 
   // if not found, select maxRRPV line of any application
-  if (victim == end) {
-    victim =
-        std::find_if(begin, end, [](BLOCK x) { return x.rrpv == maxRRPV; });
+  if (way == NUM_WAY) {
+    way = state.rrpv.find(set, maxRRPV, state.rrpv.all_ways());
   }
-  if (victim != end) {
-    stats[this].num_max_rrpv_other++;
+  if (way != NUM_WAY) {
+    state.stats.num_max_rrpv_other++;
   } else {
-    stats[this].num_diff_rrpv_same++;
+    state.stats.num_diff_rrpv_same++;
   }
 
-  uint32_t ct = 0;
-  // check if this application has any blocks in this set
-  std::for_each(begin, end, [&ct, cpu](BLOCK &x) {
-    if (x.cpu == cpu) {
-      ct++;
-    }
-  });
-
-  if (ct > 0) {
-    std::cout << "non-zero count" << std::endl;
+  if (own != 0) {
     // if not found, increment the RRPV values of blocks of the same
     // application
-    while (victim == end) {
-      std::for_each(begin, end, [cpu](BLOCK &x) {
-        if (x.cpu == cpu) {
-          x.rrpv++;
-        }
-      });
-
-      victim =
-          std::find_if(begin, end, [](BLOCK x) { return x.rrpv == maxRRPV; });
-    }
-    way = std::distance(begin, victim);
-    std::cout << "victim found: " << way << std::endl;
+    if (way == NUM_WAY)
+      way = state.rrpv.age_to(set, maxRRPV, own);
   } else {
-    std::cout << "zero count" << std::endl;
     // decay rrpv of everything
-    // if not found, increment the RRPV values of blocks of the same
-    // application
-    while (victim == end) {
-      std::for_each(begin, end, [](BLOCK &x) { x.rrpv++; });
-
-      victim =
-          std::find_if(begin, end, [](BLOCK x) { return x.rrpv == maxRRPV; });
-    }
-
-    way = std::distance(begin, victim);
-    std::cout << "victim found: " << way << std::endl;
+    if (way == NUM_WAY)
+      way = state.rrpv.age_to(set, maxRRPV, state.rrpv.all_ways());
   }
 
-  // If the EbIS is full, then evict a block
-  if (ebis[this].size() == EBIS_SIZE) {
-
-    // Figure out target application
-    uint32_t victim_cpu = app_to_evict[this] % NUM_CPUS;
-    app_to_evict[this] = (app_to_evict[this] + 1) % NUM_CPUS;
-
-    uint32_t target = 0;
-    // for each application, 1)find the closest block 2) find total number of
-    // blocks
-    auto ebisBegin = std::begin(ebis[this]);
-    auto ebisEnd = std::next(ebisBegin, EBIS_SIZE);
-    for (uint32_t id = 0; id < NUM_CPUS; id++) {
-      auto loc = std::find_if(ebisBegin, ebisEnd,
-                              [id](ebis_entry_t x) { return x.cpu == id; });
-      uint32_t minDistance = std::distance(ebisBegin, loc);
-      uint32_t numBlocks = 0;
-      for (auto &it : ebis[this]) {
-        if (it.cpu == id)
-          numBlocks++;
-      }
-
-      uint32_t curr_target = numBlocks - minDistance;
-      if (numBlocks > minDistance && curr_target > target) {
-        victim_cpu = id;
-        target = curr_target;
-      }
-    }
-
-    // Get iterator to this block
-    auto loc = std::find_if(ebisBegin, ebisEnd, [victim_cpu](ebis_entry_t x) {
-      return x.cpu == victim_cpu;
-    });
-    stats[this].ebis_evictions_per_app[(*loc).cpu]++;
-
-    // Remove the block
-    ebis[this].erase(loc);
-  }
-  ebis[this].push_back({cpu, set, full_addr});
   return way;
 }
 
@@ -173,41 +102,52 @@ void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way,
                                      uint64_t full_addr, uint64_t ip,
                                      uint64_t victim_addr, uint32_t type,
                                      uint8_t hit) {
+  auto &state = get_replacement_state<aarrip_state>();
+
   // do not update replacement state for writebacks
   if (type == WRITEBACK) {
-    block[set * NUM_WAY + way].rrpv = maxRRPV - 1;
+    state.rrpv(set, way) = maxRRPV - 1;
     return;
   }
 
   if (hit) {
-    block[set * NUM_WAY + way].rrpv = 0;
+    state.rrpv(set, way) = 0;
     return;
   }
   // miss
   // Check if the incoming block is in EbIS here by comparing the set and the
   // tag
-  auto begin = std::begin(ebis[this]);
-  auto end = std::next(begin, EBIS_SIZE);
-  auto loc = std::find_if(begin, end, [set, full_addr](ebis_entry_t x) {
-    return x.set == set && x.full_addr == full_addr;
-  });
-  if (loc == end) { // not found in EbIS
-    block[set * NUM_WAY + way].rrpv = maxRRPV - 1;
+  if (!state.ebis.contains(set, full_addr >> OFFSET_BITS)) { // not found in EbIS
+    state.rrpv(set, way) = maxRRPV - 1;
     return;
   }
-  block[set * NUM_WAY + way].rrpv = 0;
+  state.rrpv(set, way) = 0;
+}
+
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way,
+                                    const BLOCK &evicted) {
+  auto &state = get_replacement_state<aarrip_state>();
+
+  // If the EbIS is full, the oldest block of the target application is
+  // evicted
+  uint32_t evicted_cpu =
+      state.ebis.insert(evicted.cpu, set, evicted.address >> OFFSET_BITS);
+  if (evicted_cpu < NUM_CPUS)
+    state.stats.ebis_evictions_per_app[evicted_cpu]++;
 }
 
 // use this function to print out your own stats at the end of simulation
 void CACHE::replacement_final_stats() {
+  auto &state = get_replacement_state<aarrip_state>();
   std::cout << "EbIS stats for " << NAME << std::endl;
   std::cout << "Total number of max RRPV lines of same app: "
-            << stats[this].num_max_rrpv_same << std::endl;
+            << state.stats.num_max_rrpv_same << std::endl;
   std::cout << "Total number of max RRPV lines of other app: "
-            << stats[this].num_max_rrpv_other << std::endl;
+            << state.stats.num_max_rrpv_other << std::endl;
   std::cout << "Total number of different RRPV lines of same app: "
-            << stats[this].num_diff_rrpv_same << std::endl;
+            << state.stats.num_diff_rrpv_same << std::endl;
   for (uint32_t i = 0; i < NUM_CPUS; i++)
     std::cout << "Total number of EbIS evictions for cpu" << i << ": "
-              << stats[this].ebis_evictions_per_app[i] << std::endl;
+              << state.stats.ebis_evictions_per_app[i] << std::endl;
 }
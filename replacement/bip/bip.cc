@@ -1,28 +1,28 @@
-#include <algorithm>
-#include <cstdlib>
-#include <iterator>
-#include <map>
-#include <random>
-
 #include "cache.h"
-#include "util.h"
+#include "packed_ways.h"
 
 #define BTP_NUMBER 8
 
-std::map<CACHE *, uint64_t> bip_rand_seed;
+namespace {
+struct bip_state {
+  uint64_t bip_rand_seed = 1103515245 + 12345;
+  champsim::packed_ways age;
+
+  bip_state(std::size_t num_set, std::size_t num_way)
+      : age(num_set, num_way, champsim::packed_ways::OLDEST) {}
+};
+} // namespace
 
 void CACHE::initialize_replacement() {
-  bip_rand_seed[this] = 1103515245 + 12345;
+  make_replacement_state<bip_state>(NUM_SET, NUM_WAY);
 }
 
 // find replacement victim
 uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set,
                             const BLOCK *current_set, uint64_t ip,
                             uint64_t full_addr, uint32_t type) {
-  return std::distance(current_set,
-                       std::max_element(current_set,
-                                        std::next(current_set, NUM_WAY),
-                                        lru_comparator<BLOCK, BLOCK>()));
+  auto &age = get_replacement_state<bip_state>().age;
+  return age.oldest(set, age.all_ways());
 }
 
 // called on every cache hit and cache fill
@@ -33,38 +33,24 @@ void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way,
   if (hit && type == WRITEBACK)
     return;
 
-  auto begin = std::next(block.begin(), set * NUM_WAY);
-  auto end = std::next(begin, NUM_WAY);
-  uint32_t hit_lru = std::next(begin, way)->lru;
-
+  auto &state = get_replacement_state<bip_state>();
   if (hit) {
-    std::for_each(begin, end, [hit_lru](BLOCK &x) {
-      if (x.lru <= hit_lru) {
-        x.lru++;
-      }
-    });
-    std::next(begin, way)->lru = 0; // promote to the MRU position
+    state.age.promote(set, way); // promote to the MRU position
     return;
   }
   // miss
   // generate a number between 1 to 100
-  uint32_t val = (bip_rand_seed[this] / 65536) % 100;
-  bip_rand_seed[this] = bip_rand_seed[this] * 1103515245 + 12345;
+  uint32_t val = (state.bip_rand_seed / 65536) % 100;
+  state.bip_rand_seed = state.bip_rand_seed * 1103515245 + 12345;
   if (val > BTP_NUMBER) {
-    std::for_each(begin, end, [hit_lru](BLOCK &x) {
-      if (x.lru <= hit_lru) {
-        x.lru++;
-      }
-    });
-    std::next(begin, way)->lru = 0; // promote to the MRU position
+    state.age.promote(set, way); // promote to the MRU position
   } else {
-    std::for_each(begin, end, [hit_lru](BLOCK &x) {
-      if (x.lru >= hit_lru) {
-        x.lru--;
-      }
-    });
-    std::next(begin, way)->lru = NUM_WAY - 1; // demote to the LRU position
+    state.age.demote(set, way, NUM_WAY - 1); // demote to the LRU position
   }
 }
 
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way,
+                                    const BLOCK &evicted) {}
+
 void CACHE::replacement_final_stats() {}
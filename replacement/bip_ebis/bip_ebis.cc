@@ -1,94 +1,72 @@
-#include <algorithm>
-#include <cstdlib>
-#include <iterator>
-#include <map>
-#include <random>
+#include <array>
+#include <optional>
+#include <vector>
 
 #include "cache.h"
-#include "util.h"
+#include "ebis.h"
+#include "eviction_filter.h"
+#include "packed_ways.h"
 
 #define BTP_NUMBER 8
 #define EBIS_SIZE 128
 
-std::map<CACHE *, uint64_t> bip_rand_seed;
-
-struct ebis_entry_t {
-  uint32_t cpu;
-  uint32_t set;
-  uint64_t full_addr;
-};
-
+namespace {
 struct stat_entry_t {
-  uint64_t ebis_hits;
-  std::map<uint32_t, uint64_t> ebis_evictions_per_app;
-  std::map<uint32_t, uint64_t> ebis_hits_per_app;
+  uint64_t ebis_hits = 0;
+  std::array<uint64_t, NUM_CPUS> ebis_evictions_per_app = {};
+  std::array<uint64_t, NUM_CPUS> ebis_hits_per_app = {};
+  uint64_t prefetch_fills = 0, prefetches_promoted = 0,
+           unused_prefetches_evicted = 0;
 };
 
-std::map<CACHE *, stat_entry_t> stats;
+struct bip_ebis_state {
+  uint64_t bip_rand_seed = 1103515245 + 12345;
+
+  // eviction history: the exact EbIS, or a filter as large as the cache
+  std::optional<champsim::ebis> ebis;
+  std::optional<champsim::eviction_filter> filter;
+
+  stat_entry_t stats;
+  champsim::packed_ways age;
+
+  // prefetch-aware mode: prefetch fills go in at the LRU position, and a
+  // block stays marked until its first demand hit
+  const bool prefetch_aware;
+  std::vector<bool> unused_prefetch;
+
+  bip_ebis_state(std::size_t num_set, std::size_t num_way, bool use_filter,
+                 bool prefetch_aware)
+      : age(num_set, num_way, champsim::packed_ways::OLDEST),
+        prefetch_aware(prefetch_aware),
+        unused_prefetch(prefetch_aware ? num_set * num_way : 0) {
+    if (use_filter) {
+      filter.emplace(num_set * num_way);
+      return;
+    }
 
-std::map<CACHE *, std::deque<ebis_entry_t>> ebis;
+    // the EbIS starts out full of empty blocks owned by cpu0
+    ebis.emplace(EBIS_SIZE);
+    while (ebis->size() < ebis->capacity())
+      ebis->insert(0, 0, 0);
+  }
 
-std::map<CACHE *, uint32_t> app_to_evict;
+  bool recall(uint32_t set, uint64_t block) {
+    return filter ? filter->recall(block) : ebis->contains(set, block);
+  }
+};
+} // namespace
 
 void CACHE::initialize_replacement() {
-  bip_rand_seed[this] = 1103515245 + 12345;
-  ebis[this] = std::deque<ebis_entry_t>(EBIS_SIZE);
-  stats[this] = stat_entry_t{0};
-  app_to_evict[this] = 0;
+  make_replacement_state<bip_ebis_state>(NUM_SET, NUM_WAY, ebis_filter,
+                                         prefetch_aware_repl);
 }
 
 // find replacement victim
 uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set,
                             const BLOCK *current_set, uint64_t ip,
                             uint64_t full_addr, uint32_t type) {
-  uint32_t way = std::distance(
-      current_set,
-      std::max_element(current_set, std::next(current_set, NUM_WAY),
-                       lru_comparator<BLOCK, BLOCK>()));
-
-  // update EbIS
-  // Note that even though bip is NOT application aware, the ebis is
-  // if EbIS is full, evict a block
-  if (ebis[this].size() == EBIS_SIZE) {
-
-    // Figure out target application
-    uint32_t victim_cpu = app_to_evict[this] % NUM_CPUS;
-    app_to_evict[this] = (app_to_evict[this] + 1) % NUM_CPUS;
-
-    uint32_t target = 0;
-    // for each application, 1)find the closest block 2) find total number of
-    // blocks
-    auto ebisBegin = std::begin(ebis[this]);
-    auto ebisEnd = std::next(ebisBegin, EBIS_SIZE);
-    for (uint32_t id = 0; id < NUM_CPUS; id++) {
-      auto loc = std::find_if(ebisBegin, ebisEnd,
-                              [id](ebis_entry_t x) { return x.cpu == id; });
-      uint32_t minDistance = std::distance(ebisBegin, loc);
-      uint32_t numBlocks = 0;
-      for (auto &it : ebis[this]) {
-        if (it.cpu == id)
-          numBlocks++;
-      }
-
-      uint32_t curr_target = numBlocks - minDistance;
-      if (numBlocks > minDistance && curr_target > target) {
-        victim_cpu = id;
-        target = curr_target;
-      }
-    }
-
-    // Get iterator to this block
-    auto loc = std::find_if(ebisBegin, ebisEnd, [victim_cpu](ebis_entry_t x) {
-      return x.cpu == victim_cpu;
-    });
-    stats[this].ebis_evictions_per_app[(*loc).cpu]++;
-
-    // Remove the block
-    ebis[this].erase(loc);
-  }
-  ebis[this].push_back({cpu, set, full_addr});
-
-  return way;
+  auto &age = get_replacement_state<bip_ebis_state>().age;
+  return age.oldest(set, age.all_ways());
 }
 
 // called on every cache hit and cache fill
@@ -99,67 +77,96 @@ void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way,
   if (hit && type == WRITEBACK)
     return;
 
-  auto begin = std::next(block.begin(), set * NUM_WAY);
-  auto end = std::next(begin, NUM_WAY);
-  uint32_t hit_lru = std::next(begin, way)->lru;
-
+  auto &state = get_replacement_state<bip_ebis_state>();
+  const bool prefetch = state.prefetch_aware && type == PREFETCH;
   if (hit) {
-    std::for_each(begin, end, [hit_lru](BLOCK &x) {
-      if (x.lru <= hit_lru) {
-        x.lru++;
-      }
-    });
-    std::next(begin, way)->lru = 0; // promote to the MRU position
+    // in prefetch-aware mode, only demand hits promote
+    if (prefetch)
+      return;
+    if (state.prefetch_aware && state.unused_prefetch[set * NUM_WAY + way]) {
+      state.unused_prefetch[set * NUM_WAY + way] = false;
+      state.stats.prefetches_promoted++;
+    }
+
+    state.age.promote(set, way); // promote to the MRU position
     return;
   }
   // miss
+  if (state.prefetch_aware)
+    state.unused_prefetch[set * NUM_WAY + way] = prefetch;
+
+  // a prefetch fill goes in at the LRU position, without looking in the
+  // EbIS, so that a prefetch never takes credit for a demand reuse
+  if (prefetch) {
+    state.age.demote(set, way, NUM_WAY - 1); // demote to the LRU position
+    state.stats.prefetch_fills++;
+    return;
+  }
+
   // Check if incoming block is in EbIS
-  auto ebisBegin = std::begin(ebis[this]);
-  auto ebisEnd = std::next(ebisBegin, EBIS_SIZE);
-  auto loc = std::find_if(ebisBegin, ebisEnd, [set, full_addr](ebis_entry_t x) {
-    return x.set == set && x.full_addr == full_addr;
-  });
-
-  if (loc != ebisEnd) { // found in EbIS, put in MRU position always
-    stats[this].ebis_hits++;
-    stats[this].ebis_hits_per_app[cpu]++;
-    std::for_each(begin, end, [hit_lru](BLOCK &x) {
-      if (x.lru <= hit_lru) {
-        x.lru++;
-      }
-    });
-    std::next(begin, way)->lru = 0; // promote to the MRU position
+  if (state.recall(set, full_addr >> OFFSET_BITS)) { // found in EbIS, put in MRU position always
+    state.stats.ebis_hits++;
+    state.stats.ebis_hits_per_app[cpu]++;
+    state.age.promote(set, way); // promote to the MRU position
     return;
   }
 
   // generate a number between 1 to 100
-  uint32_t val = (bip_rand_seed[this] / 65536) % 100;
-  bip_rand_seed[this] = bip_rand_seed[this] * 1103515245 + 12345;
+  uint32_t val = (state.bip_rand_seed / 65536) % 100;
+  state.bip_rand_seed = state.bip_rand_seed * 1103515245 + 12345;
   if (val > BTP_NUMBER) {
-    std::for_each(begin, end, [hit_lru](BLOCK &x) {
-      if (x.lru <= hit_lru) {
-        x.lru++;
-      }
-    });
-    std::next(begin, way)->lru = 0; // promote to the MRU position
+    state.age.promote(set, way); // promote to the MRU position
   } else {
-    std::for_each(begin, end, [hit_lru](BLOCK &x) {
-      if (x.lru >= hit_lru) {
-        x.lru--;
-      }
-    });
-    std::next(begin, way)->lru = NUM_WAY - 1; // demote to the LRU position
+    state.age.demote(set, way, NUM_WAY - 1); // demote to the LRU position
+  }
+}
+
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way,
+                                    const BLOCK &evicted) {
+  auto &state = get_replacement_state<bip_ebis_state>();
+
+  // a prefetch that was never used is not worth remembering
+  if (state.prefetch_aware && state.unused_prefetch[set * NUM_WAY + way]) {
+    state.stats.unused_prefetches_evicted++;
+    return;
   }
+
+  if (state.filter) {
+    state.filter->insert(evicted.cpu, evicted.address >> OFFSET_BITS);
+    return;
+  }
+
+  // Note that even though bip is NOT application aware, the ebis is
+  // if EbIS is full, the oldest block of the target application is evicted
+  uint32_t evicted_cpu =
+      state.ebis->insert(evicted.cpu, set, evicted.address >> OFFSET_BITS);
+  if (evicted_cpu < NUM_CPUS)
+    state.stats.ebis_evictions_per_app[evicted_cpu]++;
 }
 
 void CACHE::replacement_final_stats() {
+  auto &state = get_replacement_state<bip_ebis_state>();
   std::cout << "EbIS stats for " << NAME << std::endl;
-  std::cout << "Total number of EbIS hits: " << stats[this].ebis_hits
+  std::cout << "Total number of EbIS hits: " << state.stats.ebis_hits
             << std::endl;
-  for (uint32_t i = 0; i < NUM_CPUS; i++)
-    std::cout << "Total number of EbIS evictions for cpu" << i << ": "
-              << stats[this].ebis_evictions_per_app[i] << std::endl;
+  for (uint32_t i = 0; i < NUM_CPUS; i++) {
+    if (state.filter)
+      std::cout << "Total number of eviction filter clears for cpu" << i
+                << ": " << state.filter->clears(i) << std::endl;
+    else
+      std::cout << "Total number of EbIS evictions for cpu" << i << ": "
+                << state.stats.ebis_evictions_per_app[i] << std::endl;
+  }
   for (uint32_t i = 0; i < NUM_CPUS; i++)
     std::cout << "Total number of EbIS hits for cpu" << i << ": "
-              << stats[this].ebis_hits_per_app[i] << std::endl;
+              << state.stats.ebis_hits_per_app[i] << std::endl;
+  if (state.prefetch_aware) {
+    std::cout << "Total number of prefetch fills: "
+              << state.stats.prefetch_fills << std::endl;
+    std::cout << "Total number of prefetched blocks promoted by a demand hit: "
+              << state.stats.prefetches_promoted << std::endl;
+    std::cout << "Total number of unused prefetches kept out of the EbIS: "
+              << state.stats.unused_prefetches_evicted << std::endl;
+  }
 }
@@ -1,44 +1,32 @@
-#include <algorithm>
-#include <map>
-#include <utility>
-
 #include "cache.h"
+#include "packed_ways.h"
+#include "set_dueling.h"
 
 #define BTP_NUMBER 8
 #define maxRRPV 3
 #define maxLRU NUM_WAY - 1
 #define NUM_POLICY 2
 #define SDM_SIZE 32
-#define TOTAL_SDM_SETS NUM_CPUS *NUM_POLICY *SDM_SIZE
 #define BIP_MAX 32
 #define PSEL_WIDTH 10
-#define PSEL_MAX ((1 << PSEL_WIDTH) - 1)
-#define PSEL_THRS PSEL_MAX / 2
 
-std::map<CACHE *, unsigned> rrpv_bip_counter;
-std::map<CACHE *, std::vector<std::size_t>> rand_sets;
-std::map<std::pair<CACHE *, std::size_t>, unsigned> PSEL;
-std::map<CACHE *, uint64_t> bip_rand_counter;
-std::map<CACHE *, uint64_t> bip_rand_seed;
+namespace {
+struct ddrrip_state {
+  unsigned rrpv_bip_counter = 0;
+  uint64_t bip_rand_seed = 0;
+  champsim::packed_ways rrpv, age;
 
-void CACHE::initialize_replacement() {
-  // randomly selected sampler sets
-  std::size_t rand_seed = 1103515245 + 12345;
-  for (std::size_t i = 0; i < TOTAL_SDM_SETS; i++) {
-    std::size_t val = (rand_seed / 65536) % NUM_SET;
-    auto loc = std::lower_bound(std::begin(rand_sets[this]),
-                                std::end(rand_sets[this]), val);
+  // candidate 0: DRRIP victim selection, candidate 1: BIP (LRU) victim selection
+  champsim::set_dueling<NUM_POLICY, SDM_SIZE, PSEL_WIDTH> duel;
 
-    while (loc != std::end(rand_sets[this]) && *loc == val) {
-      rand_seed = rand_seed * 1103515245 + 12345;
-      val = (rand_seed / 65536) % NUM_SET;
-      loc = std::lower_bound(std::begin(rand_sets[this]),
-                             std::end(rand_sets[this]), val);
-    }
+  ddrrip_state(std::size_t num_set, std::size_t num_way)
+      : rrpv(num_set, num_way, maxRRPV),
+        age(num_set, num_way, champsim::packed_ways::OLDEST), duel(num_set) {}
+};
+} // namespace
 
-    rand_sets[this].insert(loc, val);
-  }
-  bip_rand_counter[this] = 1103515245 + 12345;
+void CACHE::initialize_replacement() {
+  make_replacement_state<ddrrip_state>(NUM_SET, NUM_WAY);
 }
 
 // called on every cache hit and cache fill
@@ -46,9 +34,11 @@ void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way,
                                      uint64_t full_addr, uint64_t ip,
                                      uint64_t victim_addr, uint32_t type,
                                      uint8_t hit) {
+  auto &state = get_replacement_state<ddrrip_state>();
+
   // do not update replacement state for writebacks
   if (type == WRITEBACK) {
-    block[set * NUM_WAY + way].rrpv = maxRRPV - 1;
+    state.rrpv(set, way) = maxRRPV - 1;
     // Don't update LRU for writebacks!
     return;
   }
@@ -56,53 +46,32 @@ void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way,
   // cache hit
   if (hit) {
     // update RRPV
-    block[set * NUM_WAY + way].rrpv = 0; // for cache hit, DRRIP always promotes
-                                         // a cache line to the MRU position
+    state.rrpv(set, way) = 0; // for cache hit, DRRIP always promotes
+                              // a cache line to the MRU position
     // update LRU
-    auto begin = std::next(block.begin(), set * NUM_WAY);
-    auto end = std::next(begin, NUM_WAY);
-    uint64_t hit_lru = std::next(begin, way)->lru;
-    std::for_each(begin, end, [hit_lru](BLOCK &x) {
-      if (x.lru <= hit_lru)
-        x.lru++;
-    });
-    std::next(begin, way)->lru = 0; // promote to the MRU position
-                                    // for cache hit, BIP always promotes
-                                    // a cache line to the MRU position
+    state.age.promote(set, way); // promote to the MRU position
+                                 // for cache hit, BIP always promotes
+                                 // a cache line to the MRU position
     return;
   }
 
   // cache miss
   // first update RRPV value
-  block[set * NUM_WAY + way].lru = maxRRPV;
-
-  auto begin = std::next(block.begin(), set * NUM_WAY);
-  auto end = std::next(begin, NUM_WAY);
-  uint64_t hit_lru = std::next(begin, way)->lru;
+  state.rrpv(set, way) = maxRRPV;
 
-  rrpv_bip_counter[this]++;
-  if (rrpv_bip_counter[this] == BIP_MAX)
-    rrpv_bip_counter[this] = 0;
-  if (rrpv_bip_counter[this] == 0)
-    block[set * NUM_WAY + way].rrpv = maxRRPV - 1;
+  state.rrpv_bip_counter++;
+  if (state.rrpv_bip_counter == BIP_MAX)
+    state.rrpv_bip_counter = 0;
+  if (state.rrpv_bip_counter == 0)
+    state.rrpv(set, way) = maxRRPV - 1;
 
   // also update LRU value
-  uint64_t val = (bip_rand_seed[this] / 65536) % 100;
-  bip_rand_seed[this] = bip_rand_seed[this] * 1103515245 + 12345;
+  uint64_t val = (state.bip_rand_seed / 65536) % 100;
+  state.bip_rand_seed = state.bip_rand_seed * 1103515245 + 12345;
   if (val > BTP_NUMBER) {
-    std::for_each(begin, end, [hit_lru](BLOCK &x) {
-      if (x.lru <= hit_lru) {
-        x.lru++;
-      }
-    });
-    std::next(begin, way)->lru = 0; // promote to the MRU position
+    state.age.promote(set, way); // promote to the MRU position
   } else {
-    std::for_each(begin, end, [hit_lru](BLOCK &x) {
-      if (x.lru >= hit_lru) {
-        x.lru--;
-      }
-    });
-    std::next(begin, way)->lru = NUM_WAY - 1; // demote to the LRU position
+    state.age.demote(set, way, NUM_WAY - 1); // demote to the LRU position
   }
 }
 
@@ -110,70 +79,22 @@ void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way,
 uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set,
                             const BLOCK *current_set, uint64_t ip,
                             uint64_t full_addr, uint32_t type) {
-  // figure out if this set is a leader or follower set
-  auto begin =
-      std::next(std::begin(rand_sets[this]), cpu * NUM_POLICY * SDM_SIZE);
-  auto end = std::next(begin, NUM_POLICY * SDM_SIZE);
-  auto leader = std::find(begin, end, set);
-
-  if (leader == end) // follower sets
-  {
-    if (PSEL[std::make_pair(this, cpu)] > PSEL_THRS) // follow DDRIP
-    {
-      // find maxRRPV line and evict
-      // look for the maxRRPV line
-      auto begin = std::next(std::begin(block), set * NUM_WAY);
-      auto end = std::next(begin, NUM_WAY);
-      auto victim =
-          std::find_if(begin, end, [](BLOCK x) { return x.rrpv == maxRRPV; });
-      while (victim == end) {
-        for (auto it = begin; it != end; ++it)
-          it->rrpv++;
-
-        victim =
-            std::find_if(begin, end, [](BLOCK x) { return x.rrpv == maxRRPV; });
-      }
-
-      return std::distance(begin, victim);
-    } else // follow BIP
-    {
-      // find LRU line and evict
-      return std::distance(current_set,
-                           std::max_element(current_set,
-                                            std::next(current_set, NUM_WAY),
-                                            lru_comparator<BLOCK, BLOCK>()));
-    }
-  } else if ((leader - begin) % 2 == 0) // even index sets follow DRRIP
-  {
-    // UPDATE PSEL
-    if (PSEL[std::make_pair(this, cpu)] > 0)
-      PSEL[std::make_pair(this, cpu)]--;
-    // find maxRRPV line and evict
-    // look for the maxRRPV line
-    auto begin = std::next(std::begin(block), set * NUM_WAY);
-    auto end = std::next(begin, NUM_WAY);
-    auto victim =
-        std::find_if(begin, end, [](BLOCK x) { return x.rrpv == maxRRPV; });
-    while (victim == end) {
-      for (auto it = begin; it != end; ++it)
-        it->rrpv++;
-
-      victim =
-          std::find_if(begin, end, [](BLOCK x) { return x.rrpv == maxRRPV; });
-    }
-
-    return std::distance(begin, victim);
-  } else if ((leader - begin) % 2 == 1) // odd index sets follow BIP
-  {
-    if (PSEL[std::make_pair(this, cpu)] < PSEL_MAX)
-      PSEL[std::make_pair(this, cpu)]++;
-    // find LRU line and evict
-    return std::distance(current_set,
-                         std::max_element(current_set,
-                                          std::next(current_set, NUM_WAY),
-                                          lru_comparator<BLOCK, BLOCK>()));
-  }
+  auto &state = get_replacement_state<ddrrip_state>();
+  return state.duel.on_miss(
+      cpu, set,
+      [&]() -> uint32_t { // DRRIP
+        // look for the maxRRPV line, aging the set until there is one
+        return state.rrpv.age_to(set, maxRRPV, state.rrpv.all_ways());
+      },
+      [&]() -> uint32_t { // BIP
+        // find LRU line and evict
+        return state.age.oldest(set, state.age.all_ways());
+      });
 }
 
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way,
+                                    const BLOCK &evicted) {}
+
 // use this function to print out your own stats at the end of simulation
 void CACHE::replacement_final_stats() {}
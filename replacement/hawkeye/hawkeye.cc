@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <vector>
+
+#include "cache.h"
+#include "packed_ways.h"
+#include "set_roles.h"
+
+#define maxRRPV 7
+#define SAMPLER_SET (64 * NUM_CPUS)
+#define HISTORY_FACTOR 8 // OPTgen looks back this many times the associativity
+#define PRED_SIZE 2048
+#define PRED_PRIME 2039
+#define PRED_MAX 7
+
+extern uint8_t warmup_complete[NUM_CPUS];
+
+/***
+ * Hawkeye (Jain and Lin, ISCA 2016).
+ *
+ * OPTgen replays the accesses to the sampled sets against Belady's OPT: each
+ * sampled set keeps an occupancy vector over its last HISTORY_FACTOR * NUM_WAY
+ * accesses, and a reuse would have hit under OPT if the cache was never full
+ * between the two accesses. The verdict trains the predictor entry of the PC
+ * that made the earlier access, per cpu.
+ *
+ * Lines from cache-friendly PCs are inserted at RRPV 0 and age the other
+ * friendly lines; lines from cache-averse PCs are inserted at maxRRPV. When no
+ * averse line is left, the oldest friendly line is evicted and its PC
+ * detrained.
+ *
+ * Prefetches train separate predictor entries from demand accesses by the
+ * same PC. A reuse that ends in a prefetch rather than a demand access is not
+ * worth caching, since the prefetch brings the block back anyway, so it trains
+ * negatively and reserves no space in the occupancy vector.
+ */
+namespace
+{
+struct sampler_entry {
+  uint64_t block = 0;
+  uint64_t last_time = 0;
+  uint16_t signature = 0;
+  uint8_t cpu = 0;
+  bool valid = false, prefetch = false;
+};
+
+uint16_t signature(uint64_t ip, bool prefetch) { return static_cast<uint16_t>(((ip << 1) | prefetch) % PRED_PRIME); }
+
+struct hawkeye_state {
+  const std::size_t num_way, history;
+
+  // sampler; sampler_rank[set] is one past the set's rank among the sampled sets, or 0
+  champsim::set_role_table<uint16_t> sampler_rank;
+  std::vector<sampler_entry> sampler; // `history` entries per sampled set
+  std::vector<uint8_t> occupancy;     // `history` slots per sampled set, indexed by time
+  std::vector<uint64_t> sampler_time; // accesses seen by each sampled set
+
+  // prediction table
+  std::array<std::array<uint8_t, PRED_SIZE>, NUM_CPUS> predictor;
+
+  champsim::packed_ways rrpv;
+  std::vector<uint16_t> way_signature;
+  std::vector<uint8_t> way_cpu;
+
+  uint64_t optgen_access[NUM_CPUS] = {}, optgen_hit[NUM_CPUS] = {};
+  uint64_t friendly_fill[NUM_CPUS] = {}, averse_fill[NUM_CPUS] = {}, detrained = 0;
+
+  hawkeye_state(std::size_t num_set, std::size_t num_way)
+      : num_way(num_way), history(HISTORY_FACTOR * num_way),
+        sampler_rank(num_set, std::min<std::size_t>(SAMPLER_SET, num_set), [](std::size_t rank) { return static_cast<uint16_t>(rank + 1); }),
+        sampler(std::min<std::size_t>(SAMPLER_SET, num_set) * history), occupancy(std::min<std::size_t>(SAMPLER_SET, num_set) * history),
+        sampler_time(std::min<std::size_t>(SAMPLER_SET, num_set)), rrpv(num_set, num_way, maxRRPV), way_signature(num_set * num_way),
+        way_cpu(num_set * num_way)
+  {
+    for (auto& table : predictor)
+      table.fill((PRED_MAX + 1) / 2);
+  }
+
+  bool friendly(uint32_t cpu, uint16_t sig) const { return predictor[cpu][sig] > PRED_MAX / 2; }
+
+  void train(uint32_t cpu, uint16_t sig, bool positive)
+  {
+    auto& ctr = predictor[cpu][sig];
+    if (positive && ctr < PRED_MAX)
+      ctr++;
+    else if (!positive && ctr > 0)
+      ctr--;
+  }
+
+  // would OPT have kept the block from `then` to `now`? If so, reserve the space
+  bool optgen(std::size_t rank, uint64_t then, uint64_t now)
+  {
+    uint8_t* occ = &occupancy[rank * history];
+    for (uint64_t t = then; t < now; ++t) {
+      if (occ[t % history] >= num_way)
+        return false;
+    }
+    for (uint64_t t = then; t < now; ++t)
+      occ[t % history]++;
+    return true;
+  }
+
+  void sample(std::size_t rank, uint32_t cpu, uint64_t block, uint16_t sig, bool prefetch)
+  {
+    const uint64_t now = sampler_time[rank]++;
+    occupancy[rank * history + now % history] = 0;
+
+    auto begin = std::next(std::begin(sampler), rank * history);
+    auto end = std::next(begin, history);
+    auto match = std::find_if(begin, end, [block](const sampler_entry& e) { return e.valid && e.block == block; });
+
+    if (match != end && now - match->last_time < history) {
+      bool hit = !prefetch && optgen(rank, match->last_time, now);
+      train(match->cpu, match->signature, hit);
+
+      if (warmup_complete[cpu] && !prefetch) {
+        optgen_access[cpu]++;
+        optgen_hit[cpu] += hit;
+      }
+    } else {
+      // a stale entry, or the least recently used one: its access was not
+      // reused within the history, so OPT would have missed
+      if (match == end)
+        match = std::min_element(begin, end, [](const sampler_entry& x, const sampler_entry& y) { return !x.valid || (y.valid && x.last_time < y.last_time); });
+      if (match->valid)
+        train(match->cpu, match->signature, false);
+
+      if (warmup_complete[cpu] && !prefetch)
+        optgen_access[cpu]++;
+    }
+
+    *match = {block, now, sig, static_cast<uint8_t>(cpu), true, prefetch};
+  }
+};
+} // namespace
+
+// initialize replacement state
+void CACHE::initialize_replacement() { make_replacement_state<hawkeye_state>(NUM_SET, NUM_WAY); }
+
+// find replacement victim
+uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK* current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+{
+  auto& state = get_replacement_state<hawkeye_state>();
+
+  // evict a cache-averse line if there is one
+  uint8_t oldest = state.rrpv.max(set, state.rrpv.all_ways());
+  uint32_t victim = state.rrpv.find(set, oldest, state.rrpv.all_ways());
+  if (oldest == maxRRPV)
+    return victim;
+
+  // otherwise the oldest friendly line was predicted wrongly
+  state.train(state.way_cpu[set * NUM_WAY + victim], state.way_signature[set * NUM_WAY + victim], false);
+  state.detrained++;
+  return victim;
+}
+
+// called on every cache hit and cache fill
+void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type,
+                                     uint8_t hit)
+{
+  auto& state = get_replacement_state<hawkeye_state>();
+
+  // writebacks are not predicted
+  if (type == WRITEBACK) {
+    if (!hit)
+      state.rrpv(set, way) = maxRRPV;
+    return;
+  }
+
+  const bool prefetch = (type == PREFETCH);
+  const uint16_t sig = signature(ip, prefetch);
+
+  if (auto s_rank = state.sampler_rank[set]; s_rank > 0)
+    state.sample(s_rank - 1, cpu, full_addr >> OFFSET_BITS, sig, prefetch);
+
+  if (way >= NUM_WAY)
+    return;
+
+  state.way_signature[set * NUM_WAY + way] = sig;
+  state.way_cpu[set * NUM_WAY + way] = static_cast<uint8_t>(cpu);
+
+  if (!state.friendly(cpu, sig)) {
+    state.rrpv(set, way) = maxRRPV;
+    if (!hit)
+      state.averse_fill[cpu]++;
+    return;
+  }
+
+  // age the other friendly lines on a fill, leaving room below the averse ones
+  if (!hit) {
+    for (uint32_t i = 0; i < NUM_WAY; ++i) {
+      if (state.rrpv(set, i) < maxRRPV - 1)
+        state.rrpv(set, i)++;
+    }
+    state.friendly_fill[cpu]++;
+  }
+  state.rrpv(set, way) = 0;
+}
+
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way, const BLOCK& evicted) {}
+
+// use this function to print out your own stats at the end of simulation
+void CACHE::replacement_final_stats()
+{
+  auto& state = get_replacement_state<hawkeye_state>();
+  for (uint32_t cpu = 0; cpu < NUM_CPUS; ++cpu) {
+    std::cout << NAME << " Hawkeye cpu" << cpu << " OPTgen accesses: " << state.optgen_access[cpu] << "  OPT hit rate: "
+              << (state.optgen_access[cpu] > 0 ? (100.0 * state.optgen_hit[cpu]) / state.optgen_access[cpu] : 0.0) << "%"
+              << "  friendly fills: " << state.friendly_fill[cpu] << "  averse fills: " << state.averse_fill[cpu] << std::endl;
+  }
+  std::cout << NAME << " Hawkeye friendly lines evicted: " << state.detrained << std::endl;
+}
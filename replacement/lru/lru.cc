@@ -1,16 +1,23 @@
-#include <algorithm>
-#include <iterator>
-
 #include "cache.h"
-#include "util.h"
+#include "packed_ways.h"
+
+namespace
+{
+struct lru_state {
+  champsim::packed_ways age;
 
-void CACHE::initialize_replacement() {}
+  lru_state(std::size_t num_set, std::size_t num_way) : age(num_set, num_way, champsim::packed_ways::OLDEST) {}
+};
+} // namespace
+
+void CACHE::initialize_replacement() { make_replacement_state<lru_state>(NUM_SET, NUM_WAY); }
 
 // find replacement victim
 uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK* current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
 {
   // baseline LRU
-  return std::distance(current_set, std::max_element(current_set, std::next(current_set, NUM_WAY), lru_comparator<BLOCK, BLOCK>()));
+  auto& age = get_replacement_state<lru_state>().age;
+  return age.oldest(set, age.all_ways());
 }
 
 // called on every cache hit and cache fill
@@ -20,14 +27,10 @@ void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, u
   if (hit && type == WRITEBACK)
     return;
 
-  auto begin = std::next(block.begin(), set * NUM_WAY);
-  auto end = std::next(begin, NUM_WAY);
-  uint32_t hit_lru = std::next(begin, way)->lru;
-  std::for_each(begin, end, [hit_lru](BLOCK& x) {
-    if (x.lru <= hit_lru)
-      x.lru++;
-  });
-  std::next(begin, way)->lru = 0; // promote to the MRU position
+  get_replacement_state<lru_state>().age.promote(set, way); // promote to the MRU position
 }
 
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way, const BLOCK& evicted) {}
+
 void CACHE::replacement_final_stats() {}
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "cache.h"
+#include "packed_ways.h"
+#include "set_roles.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define maxRRPV 3
+#define SAMPLER_SET (32 * NUM_CPUS)
+#define NUM_FEATURES 16
+#define LOG_TABLE_SIZE 12
+#define TABLE_SIZE (1 << LOG_TABLE_SIZE)
+#define PC_HISTORY 3
+#define WEIGHT_MAX 31
+#define WEIGHT_MIN (-32)
+#define THETA 100             // train while the sum is closer to zero than this
+#define BYPASS_THRESHOLD 100  // at or above: do not fill the LLC at all
+#define DEAD_THRESHOLD 40     // at or above: insert at maxRRPV, and do not promote on a hit
+#define REUSE_THRESHOLD (-40) // below: insert at RRPV 0
+
+/***
+ * Multiperspective reuse prediction (Jiménez and Teran, MICRO 2017), with the
+ * hashed perceptron of branch/hashed_perceptron applied to blocks instead of
+ * branches.
+ *
+ * Every access is described by NUM_FEATURES features: the PC, the last few PCs
+ * this cpu sent to the cache, parts of the address, the cpu and whether it is
+ * a prefetch, alone and in combinations. Each feature is hashed into its own
+ * table of 6-bit weights, and the sum of the selected weights predicts whether
+ * the block is dead (positive) or will be reused (negative). The prediction
+ * picks the insertion RRPV, and a strongly dead block is not filled at all in
+ * the LLC.
+ *
+ * Training happens on SHiP-style sampler sets, which keep an LRU tag array as
+ * deep as the cache with the feature indices of each block's last access. A
+ * sampler hit trains those indices towards reuse; a block falling out of the
+ * sampler trains them towards dead. Like the branch predictor, weights only
+ * move when the prediction was wrong or not confident.
+ *
+ * The selected weights of all features fit one SSE2 register, and are summed
+ * with a single sum of absolute differences.
+ */
+namespace
+{
+using feature_indices = std::array<uint16_t, NUM_FEATURES>;
+
+struct sampler_entry {
+  uint64_t block = 0;
+  feature_indices indices = {};
+  int32_t sum = 0;
+  bool valid = false;
+};
+
+struct multiperspective_state {
+  // weights; each row is one feature's table
+  std::array<std::array<int8_t, TABLE_SIZE>, NUM_FEATURES> weights = {};
+
+  // last PCs each cpu sent to this cache, most recent first
+  std::array<std::array<uint64_t, PC_HISTORY>, NUM_CPUS> pc_history = {};
+
+  // sampler; sampler_rank[set] is one past the set's rank among the sampled sets, or 0
+  champsim::set_role_table<uint16_t> sampler_rank;
+  std::vector<sampler_entry> sampler;
+  champsim::packed_ways sampler_age;
+  const std::size_t num_way;
+
+  champsim::packed_ways rrpv;
+  const bool may_bypass;
+
+  uint64_t fills = 0, bypassed = 0, inserted_dead = 0, inserted_reused = 0, trained = 0;
+
+  multiperspective_state(std::size_t num_set, std::size_t num_way, bool may_bypass)
+      : sampler_rank(num_set, std::min<std::size_t>(SAMPLER_SET, num_set), [](std::size_t rank) { return static_cast<uint16_t>(rank + 1); }),
+        sampler(std::min<std::size_t>(SAMPLER_SET, num_set) * num_way),
+        sampler_age(std::min<std::size_t>(SAMPLER_SET, num_set), num_way, champsim::packed_ways::OLDEST), num_way(num_way),
+        rrpv(num_set, num_way, maxRRPV), may_bypass(may_bypass)
+  {
+  }
+
+  static uint16_t hash(uint64_t val, unsigned feature)
+  {
+    return static_cast<uint16_t>(((val ^ (uint64_t{feature} << 56)) * 0x9e3779b97f4a7c15ull) >> (64 - LOG_TABLE_SIZE));
+  }
+
+  feature_indices features(uint32_t cpu, uint64_t ip, uint64_t full_addr, uint32_t type, uint32_t offset_bits) const
+  {
+    const uint64_t block = full_addr >> offset_bits;
+    const uint64_t prefetch = (type == PREFETCH);
+    const auto& hist = pc_history[cpu];
+
+    return {hash(cpu, 0),
+            hash(ip, 1),
+            hash((ip << 1) | prefetch, 2),
+            hash(hist[0], 3),
+            hash(hist[1], 4),
+            hash(hist[2], 5),
+            hash(ip ^ (hist[0] << 7), 6),
+            hash(ip ^ (hist[0] << 7) ^ (hist[1] << 14), 7),
+            hash(block >> 6, 8),
+            hash(block >> 10, 9),
+            hash((ip << 6) ^ (block & 0x3f), 10),
+            hash((ip << 8) ^ ((block >> 6) & 0xff), 11),
+            hash((ip << 4) ^ cpu, 12),
+            hash((ip << 3) ^ type, 13),
+            hash(ip >> 4, 14),
+            hash((ip << 4) ^ ((full_addr >> 2) & 0xf), 15)};
+  }
+
+  int32_t predict(const feature_indices& idx) const
+  {
+#ifdef __SSE2__
+    alignas(16) std::array<int8_t, NUM_FEATURES> selected;
+    for (std::size_t f = 0; f < NUM_FEATURES; ++f)
+      selected[f] = weights[f][idx[f]];
+
+    // bias the signed weights to unsigned, then sum each half against zero
+    __m128i v = _mm_xor_si128(_mm_load_si128(reinterpret_cast<const __m128i*>(selected.data())), _mm_set1_epi8(static_cast<char>(0x80)));
+    __m128i halves = _mm_sad_epu8(v, _mm_setzero_si128());
+    return _mm_cvtsi128_si32(halves) + _mm_extract_epi16(halves, 4) - 128 * NUM_FEATURES;
+#else
+    int32_t sum = 0;
+    for (std::size_t f = 0; f < NUM_FEATURES; ++f)
+      sum += weights[f][idx[f]];
+    return sum;
+#endif
+  }
+
+  void train(const sampler_entry& entry, bool dead)
+  {
+    if ((entry.sum >= DEAD_THRESHOLD) == dead && std::abs(entry.sum) >= THETA)
+      return;
+
+    for (std::size_t f = 0; f < NUM_FEATURES; ++f) {
+      auto& w = weights[f][entry.indices[f]];
+      if (dead && w < WEIGHT_MAX)
+        w++;
+      else if (!dead && w > WEIGHT_MIN)
+        w--;
+    }
+    trained++;
+  }
+
+  void sample(std::size_t rank, uint64_t block, const feature_indices& idx, int32_t sum)
+  {
+    sampler_entry* set_begin = &sampler[rank * num_way];
+    sampler_entry* match = std::find_if(set_begin, set_begin + num_way, [block](const sampler_entry& e) { return e.valid && e.block == block; });
+
+    if (match != set_begin + num_way) {
+      train(*match, false);
+    } else {
+      match = set_begin + sampler_age.oldest(rank, sampler_age.all_ways());
+      if (match->valid)
+        train(*match, true);
+    }
+
+    *match = {block, idx, sum, true};
+    sampler_age.promote(rank, std::distance(set_begin, match));
+  }
+};
+} // namespace
+
+// initialize replacement state
+void CACHE::initialize_replacement()
+{
+  // only the last level, the one in front of memory, may be bypassed
+  make_replacement_state<multiperspective_state>(NUM_SET, NUM_WAY, in_front_of_memory);
+}
+
+// find replacement victim
+uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK* current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+{
+  auto& state = get_replacement_state<multiperspective_state>();
+
+  // never bypass a writeback
+  if (state.may_bypass && type != WRITEBACK && state.predict(state.features(cpu, ip, full_addr, type, OFFSET_BITS)) >= BYPASS_THRESHOLD)
+    return NUM_WAY;
+
+  return state.rrpv.age_to(set, maxRRPV, state.rrpv.all_ways());
+}
+
+// called on every cache hit and cache fill
+void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type,
+                                     uint8_t hit)
+{
+  auto& state = get_replacement_state<multiperspective_state>();
+
+  // writebacks are not predicted
+  if (type == WRITEBACK) {
+    if (!hit)
+      state.rrpv(set, way) = maxRRPV - 1;
+    return;
+  }
+
+  const feature_indices idx = state.features(cpu, ip, full_addr, type, OFFSET_BITS);
+  const int32_t sum = state.predict(idx);
+
+  if (auto s_rank = state.sampler_rank[set]; s_rank > 0)
+    state.sample(s_rank - 1, full_addr >> OFFSET_BITS, idx, sum);
+
+  auto& hist = state.pc_history[cpu];
+  std::copy_backward(std::begin(hist), std::prev(std::end(hist)), std::end(hist));
+  hist[0] = ip;
+
+  if (!hit) {
+    state.fills++;
+    if (way == NUM_WAY) {
+      state.bypassed++;
+      return;
+    }
+  }
+
+  if (sum >= DEAD_THRESHOLD) {
+    // a dead block is not promoted
+    if (!hit) {
+      state.rrpv(set, way) = maxRRPV;
+      state.inserted_dead++;
+    }
+  } else if (hit || sum < REUSE_THRESHOLD) {
+    state.rrpv(set, way) = 0;
+    state.inserted_reused += !hit;
+  } else {
+    state.rrpv(set, way) = maxRRPV - 1;
+  }
+}
+
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way, const BLOCK& evicted) {}
+
+// use this function to print out your own stats at the end of simulation
+void CACHE::replacement_final_stats()
+{
+  auto& state = get_replacement_state<multiperspective_state>();
+  std::cout << NAME << " multiperspective fills: " << state.fills << "  bypassed: " << state.bypassed << "  inserted dead: " << state.inserted_dead
+            << "  inserted at RRPV 0: " << state.inserted_reused << "  training updates: " << state.trained << std::endl;
+}
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "access_stream.h"
+#include "cache.h"
+
+// records looked ahead of the current access; reuses further away than this
+// are treated as never
+#define LOOKAHEAD (1 << 20)
+#define NEVER UINT64_MAX
+
+extern uint8_t warmup_complete[NUM_CPUS];
+
+/***
+ * Belady's OPT: evict the block whose next use is furthest in the future.
+ *
+ * The future is the access stream named by $OPT_ACCESS_STREAM, captured from
+ * this cache in an earlier run (see access_stream.h). Every access this cache
+ * reports through update_replacement_state consumes one record of the stream,
+ * which lines up exactly when the stream is replayed through the same cache
+ * with champsim_replay, and approximately in a second timing run.
+ *
+ * Only a window of LOOKAHEAD records is decoded at a time. As each record
+ * enters the window it is linked from the previous record of the same block,
+ * found through a hash map, so memory does not grow with the length of the
+ * stream. When a block is accessed its next use is read from the link and kept
+ * with its way, and the victim search only compares the ways of one set.
+ */
+namespace
+{
+struct window_entry {
+  uint64_t block_addr;
+  uint64_t next_use; // position of the next record of the same block, or NEVER
+};
+
+struct block_uses {
+  uint64_t first, last; // positions of the block's first and last records in the window
+};
+
+struct opt_state {
+  champsim::access_stream::reader stream;
+  std::size_t next_block = 0;
+  std::optional<champsim::access_stream::block_decoder> decoder;
+  const uint32_t offset_bits;
+
+  // records [now, end) of the stream, in a ring indexed by position
+  std::vector<window_entry> window = std::vector<window_entry>(LOOKAHEAD);
+  uint64_t now = 0, end = 0;
+  std::unordered_map<uint64_t, block_uses> uses;
+
+  // next use of the block in each way, as of its last access
+  std::vector<uint64_t> way_next_use;
+
+  uint64_t mismatched = 0, past_end = 0;
+  uint64_t access[NUM_CPUS][NUM_TYPES] = {}, hit[NUM_CPUS][NUM_TYPES] = {}, miss[NUM_CPUS][NUM_TYPES] = {};
+
+  opt_state(const char* path, uint32_t offset_bits, std::size_t num_set, std::size_t num_way)
+      : stream(path), offset_bits(offset_bits), way_next_use(num_set * num_way, NEVER)
+  {
+    uses.reserve(LOOKAHEAD);
+    refill();
+  }
+
+  bool pull(champsim::access_stream::access& acc)
+  {
+    while (!decoder || decoder->done()) {
+      if (next_block == stream.num_blocks())
+        return false;
+      decoder = stream.decode(next_block++);
+    }
+    acc = decoder->get();
+    return true;
+  }
+
+  void refill()
+  {
+    champsim::access_stream::access acc;
+    while (end - now < LOOKAHEAD && pull(acc)) {
+      if (acc.fill)
+        continue; // the cache fills its own misses
+
+      uint64_t block_addr = acc.address >> offset_bits;
+      window[end % LOOKAHEAD] = {block_addr, NEVER};
+
+      auto [found, inserted] = uses.try_emplace(block_addr, block_uses{end, end});
+      if (!inserted) {
+        window[found->second.last % LOOKAHEAD].next_use = end;
+        found->second.last = end;
+      }
+      end++;
+    }
+  }
+
+  // move past the record for the access just made to block_addr, and return
+  // the block's next use
+  uint64_t consume(uint64_t block_addr)
+  {
+    if (now == end) {
+      past_end++;
+      return NEVER;
+    }
+
+    const window_entry current = window[now % LOOKAHEAD];
+    if (current.next_use == NEVER)
+      uses.erase(current.block_addr);
+    else
+      uses[current.block_addr].first = current.next_use;
+
+    now++;
+    refill();
+
+    if (current.block_addr == block_addr)
+      return current.next_use;
+
+    // the run has drifted from the stream; look the block up instead
+    mismatched++;
+    auto found = uses.find(block_addr);
+    return found == std::end(uses) ? NEVER : found->second.first;
+  }
+};
+} // namespace
+
+void CACHE::initialize_replacement()
+{
+  const char* path = std::getenv("OPT_ACCESS_STREAM");
+  if (path == nullptr) {
+    std::cerr << NAME << ": the opt replacement policy needs OPT_ACCESS_STREAM to name an access stream captured from this cache" << std::endl;
+    assert(0);
+  }
+
+  make_replacement_state<opt_state>(path, OFFSET_BITS, NUM_SET, NUM_WAY);
+}
+
+// find replacement victim
+uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK* current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+{
+  auto& state = get_replacement_state<opt_state>();
+
+  const uint64_t* next_use = &state.way_next_use[set * NUM_WAY];
+  return std::distance(next_use, std::max_element(next_use, next_use + NUM_WAY));
+}
+
+// called on every cache hit and cache fill
+void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type,
+                                     uint8_t hit)
+{
+  auto& state = get_replacement_state<opt_state>();
+  uint64_t next_use = state.consume(full_addr >> OFFSET_BITS);
+  if (way < NUM_WAY)
+    state.way_next_use[set * NUM_WAY + way] = next_use;
+
+  if (warmup_complete[cpu]) {
+    state.access[cpu][type]++;
+    if (hit)
+      state.hit[cpu][type]++;
+    else
+      state.miss[cpu][type]++;
+  }
+}
+
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way, const BLOCK& evicted) {}
+
+void CACHE::replacement_final_stats()
+{
+  auto& state = get_replacement_state<opt_state>();
+  const char* type_names[NUM_TYPES] = {" LOAD      ", " RFO       ", " PREFETCH  ", " WRITEBACK ", " TRANSLATION "};
+
+  std::cout << std::endl << NAME << " OPT statistics (after warmup)" << std::endl;
+  for (uint32_t cpu = 0; cpu < NUM_CPUS; cpu++) {
+    uint64_t TOTAL_ACCESS = 0, TOTAL_HIT = 0, TOTAL_MISS = 0;
+    for (uint32_t i = 0; i < NUM_TYPES; i++) {
+      TOTAL_ACCESS += state.access[cpu][i];
+      TOTAL_HIT += state.hit[cpu][i];
+      TOTAL_MISS += state.miss[cpu][i];
+    }
+
+    std::cout << "CPU " << cpu << std::endl;
+    std::cout << NAME << " TOTAL     ACCESS: " << std::setw(10) << TOTAL_ACCESS << "  HIT: " << std::setw(10) << TOTAL_HIT << "  MISS: " << std::setw(10)
+              << TOTAL_MISS << std::endl;
+    for (uint32_t i = 0; i < NUM_TYPES; i++)
+      std::cout << NAME << type_names[i] << "ACCESS: " << std::setw(10) << state.access[cpu][i] << "  HIT: " << std::setw(10) << state.hit[cpu][i]
+                << "  MISS: " << std::setw(10) << state.miss[cpu][i] << std::endl;
+  }
+
+  std::cout << NAME << " OPT stream records used: " << state.now << "  mismatched: " << state.mismatched << "  accesses past the end: " << state.past_end
+            << std::endl;
+}
@@ -1,10 +1,10 @@
 #include <algorithm>
 #include <array>
-#include <map>
-#include <utility>
 #include <vector>
 
 #include "cache.h"
+#include "packed_ways.h"
+#include "set_roles.h"
 
 #define maxRRPV 3
 #define SHCT_SIZE 16384
@@ -22,76 +22,62 @@ public:
   uint32_t lru = 9999999;
 };
 
-// sampler
-std::map<CACHE*, std::vector<std::size_t>> rand_sets;
-std::map<CACHE*, std::vector<SAMPLER_class>> sampler;
+namespace
+{
+struct ship_state {
+  // sampler; sampler_rank[set] is one past the set's rank among the sampled sets, or 0
+  champsim::set_role_table<uint16_t> sampler_rank;
+  std::vector<SAMPLER_class> sampler;
 
-// prediction table structure
-std::map<std::pair<CACHE*, std::size_t>, std::array<unsigned, SHCT_SIZE>> SHCT;
+  // prediction table
+  std::array<std::array<unsigned, SHCT_SIZE>, NUM_CPUS> SHCT = {};
 
-// initialize replacement state
-void CACHE::initialize_replacement()
-{
-  // randomly selected sampler sets
-  std::size_t rand_seed = 1103515245 + 12345;
-  ;
-  for (std::size_t i = 0; i < SAMPLER_SET; i++) {
-    std::size_t val = (rand_seed / 65536) % NUM_SET;
-    std::vector<std::size_t>::iterator loc = std::lower_bound(std::begin(rand_sets[this]), std::end(rand_sets[this]), val);
-
-    while (loc != std::end(rand_sets[this]) && *loc == val) {
-      rand_seed = rand_seed * 1103515245 + 12345;
-      val = (rand_seed / 65536) % NUM_SET;
-      loc = std::lower_bound(std::begin(rand_sets[this]), std::end(rand_sets[this]), val);
-    }
+  champsim::packed_ways rrpv;
 
-    rand_sets[this].insert(loc, val);
+  ship_state(std::size_t num_set, std::size_t num_way)
+      : sampler_rank(num_set, SAMPLER_SET, [](std::size_t rank) { return static_cast<uint16_t>(rank + 1); }), sampler(SAMPLER_SET * num_way),
+        rrpv(num_set, num_way, maxRRPV)
+  {
   }
+};
+} // namespace
 
-  sampler.emplace(this, SAMPLER_SET * NUM_WAY);
-}
+// initialize replacement state
+void CACHE::initialize_replacement() { make_replacement_state<ship_state>(NUM_SET, NUM_WAY); }
 
 // find replacement victim
 uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK* current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
 {
-  // look for the maxRRPV line
-  auto begin = std::next(std::begin(block), set * NUM_WAY);
-  auto end = std::next(begin, NUM_WAY);
-  auto victim = std::find_if(begin, end, [](BLOCK x) { return x.lru == maxRRPV; }); // hijack the lru field
-  while (victim == end) {
-    for (auto it = begin; it != end; ++it)
-      it->lru++;
-
-    victim = std::find_if(begin, end, [](BLOCK x) { return x.lru == maxRRPV; });
-  }
-
-  return std::distance(begin, victim);
+  // look for the maxRRPV line, aging the set until there is one
+  auto& rrpv = get_replacement_state<ship_state>().rrpv;
+  return rrpv.age_to(set, maxRRPV, rrpv.all_ways());
 }
 
 // called on every cache hit and cache fill
 void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type,
                                      uint8_t hit)
 {
+  auto& state = get_replacement_state<ship_state>();
+
   // handle writeback access
   if (type == WRITEBACK) {
     if (!hit)
-      block[set * NUM_WAY + way].lru = maxRRPV - 1;
+      state.rrpv(set, way) = maxRRPV - 1;
 
     return;
   }
 
   // update sampler
-  auto s_idx = std::find(std::begin(rand_sets[this]), std::end(rand_sets[this]), set);
-  if (s_idx != std::end(rand_sets[this])) {
-    auto s_set_begin = std::next(std::begin(sampler[this]), std::distance(std::begin(rand_sets[this]), s_idx));
+  if (auto s_rank = state.sampler_rank[set]; s_rank > 0) {
+    auto s_set_begin = std::next(std::begin(state.sampler), s_rank - 1);
     auto s_set_end = std::next(s_set_begin, NUM_WAY);
 
     // check hit
     auto match = std::find_if(s_set_begin, s_set_end, eq_addr<SAMPLER_class>(full_addr, 8 + lg2(NUM_WAY)));
     if (match != s_set_end) {
       uint32_t SHCT_idx = match->ip % SHCT_PRIME;
-      if (SHCT[std::make_pair(this, cpu)][SHCT_idx] > 0)
-        SHCT[std::make_pair(this, cpu)][SHCT_idx]--;
+      if (state.SHCT[cpu][SHCT_idx] > 0)
+        state.SHCT[cpu][SHCT_idx]--;
 
       match->type = type;
       match->used = 1;
@@ -100,8 +86,8 @@ void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, u
 
       if (match->used) {
         uint32_t SHCT_idx = match->ip % SHCT_PRIME;
-        if (SHCT[std::make_pair(this, cpu)][SHCT_idx] < SHCT_MAX)
-          SHCT[std::make_pair(this, cpu)][SHCT_idx]++;
+        if (state.SHCT[cpu][SHCT_idx] < SHCT_MAX)
+          state.SHCT[cpu][SHCT_idx]++;
       }
 
       match->valid = 1;
@@ -118,16 +104,19 @@ void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, u
   }
 
   if (hit)
-    block[set * NUM_WAY + way].lru = 0;
+    state.rrpv(set, way) = 0;
   else {
     // SHIP prediction
     uint32_t SHCT_idx = ip % SHCT_PRIME;
 
-    block[set * NUM_WAY + way].lru = maxRRPV - 1;
-    if (SHCT[std::make_pair(this, cpu)][SHCT_idx] == SHCT_MAX)
-      block[set * NUM_WAY + way].lru = maxRRPV;
+    state.rrpv(set, way) = maxRRPV - 1;
+    if (state.SHCT[cpu][SHCT_idx] == SHCT_MAX)
+      state.rrpv(set, way) = maxRRPV;
   }
 }
 
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way, const BLOCK& evicted) {}
+
 // use this function to print out your own stats at the end of simulation
 void CACHE::replacement_final_stats() {}
@@ -1,40 +1,41 @@
 #include "cache.h"
+#include "packed_ways.h"
 
 #define maxRRPV 3
 
-// initialize replacement state
-void CACHE::initialize_replacement()
+namespace
 {
-  for (auto& blk : block)
-    blk.lru = maxRRPV;
-}
+struct srrip_state {
+  champsim::packed_ways rrpv;
+
+  srrip_state(std::size_t num_set, std::size_t num_way) : rrpv(num_set, num_way, maxRRPV) {}
+};
+} // namespace
+
+// initialize replacement state
+void CACHE::initialize_replacement() { make_replacement_state<srrip_state>(NUM_SET, NUM_WAY); }
 
 // find replacement victim
 uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK* current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
 {
-  // look for the maxRRPV line
-  auto begin = std::next(std::begin(block), set * NUM_WAY);
-  auto end = std::next(begin, NUM_WAY);
-  auto victim = std::find_if(begin, end, [](BLOCK x) { return x.lru == maxRRPV; }); // hijack the lru field
-  while (victim == end) {
-    for (auto it = begin; it != end; ++it)
-      it->lru++;
-
-    victim = std::find_if(begin, end, [](BLOCK x) { return x.lru == maxRRPV; });
-  }
-
-  return std::distance(begin, victim);
+  // look for the maxRRPV line, aging the set until there is one
+  auto& rrpv = get_replacement_state<srrip_state>().rrpv;
+  return rrpv.age_to(set, maxRRPV, rrpv.all_ways());
 }
 
 // called on every cache hit and cache fill
 void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type,
                                      uint8_t hit)
 {
+  auto& rrpv = get_replacement_state<srrip_state>().rrpv;
   if (hit)
-    block[set * NUM_WAY + way].lru = 0;
+    rrpv(set, way) = 0;
   else
-    block[set * NUM_WAY + way].lru = maxRRPV - 1;
+    rrpv(set, way) = maxRRPV - 1;
 }
 
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way, const BLOCK& evicted) {}
+
 // use this function to print out your own stats at the end of simulation
 void CACHE::replacement_final_stats() {}
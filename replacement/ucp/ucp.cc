@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <vector>
+
+#include "cache.h"
+#include "packed_ways.h"
+#include "set_roles.h"
+
+#define UMON_SETS 32
+#define PARTITION_INTERVAL 5000000
+
+/***
+ * Utility-based cache partitioning (Qureshi and Patt, MICRO 2006).
+ *
+ * Every cpu has a utility monitor: an LRU tag directory for UMON_SETS sampled
+ * sets that only its own accesses go through, counting hits at each stack
+ * position. Hits at position p would be kept by a partition of more than p
+ * ways, so the counters give each cpu's hits for any number of ways.
+ *
+ * Every PARTITION_INTERVAL cycles the ways are divided with the lookahead
+ * algorithm and the counters are halved. Victims are chosen by LRU among the
+ * cpu's own blocks once it holds its quota of the set, and otherwise among
+ * the blocks of cpus over their quota, using the tag array's per-cpu way masks.
+ */
+namespace
+{
+struct ucp_state {
+  champsim::packed_ways age;
+
+  // utility monitors, one per cpu
+  champsim::set_role_table<uint16_t> umon_rank; // one past the rank of a sampled set, or 0
+  std::array<std::vector<uint64_t>, NUM_CPUS> umon_tags;
+  std::vector<champsim::packed_ways> umon_age;
+  std::array<std::vector<uint64_t>, NUM_CPUS> umon_hits;
+
+  std::array<uint32_t, NUM_CPUS> quota;
+  uint64_t next_partition = PARTITION_INTERVAL;
+  uint64_t num_partitions = 0;
+
+  ucp_state(std::size_t num_set, std::size_t num_way)
+      : age(num_set, num_way, champsim::packed_ways::OLDEST),
+        umon_rank(num_set, std::min<std::size_t>(UMON_SETS, num_set), [](std::size_t rank) { return static_cast<uint16_t>(rank + 1); })
+  {
+    for (std::size_t cpu = 0; cpu < NUM_CPUS; ++cpu) {
+      umon_tags[cpu].resize(std::min<std::size_t>(UMON_SETS, num_set) * num_way);
+      umon_age.emplace_back(std::min<std::size_t>(UMON_SETS, num_set), num_way, champsim::packed_ways::OLDEST);
+      umon_hits[cpu].resize(num_way);
+    }
+
+    // start from an even split
+    for (std::size_t cpu = 0; cpu < NUM_CPUS; ++cpu)
+      quota[cpu] = static_cast<uint32_t>(num_way / NUM_CPUS + (cpu < num_way % NUM_CPUS));
+  }
+
+  void monitor(uint32_t cpu, std::size_t rank, uint64_t tag, std::size_t num_way)
+  {
+    uint64_t* tags = &umon_tags[cpu][rank * num_way];
+    auto& ages = umon_age[cpu];
+
+    uint32_t way = static_cast<uint32_t>(std::distance(tags, std::find(tags, tags + num_way, tag)));
+    if (way < num_way && ages(rank, way) != champsim::packed_ways::OLDEST) {
+      umon_hits[cpu][ages(rank, way)]++;
+    } else {
+      way = ages.oldest(rank, ages.all_ways());
+      tags[way] = tag;
+    }
+    ages.promote(rank, way);
+  }
+
+  // hits cpu would have had with the given number of ways
+  uint64_t utility(uint32_t cpu, std::size_t ways) const
+  {
+    uint64_t hits = 0;
+    for (std::size_t i = 0; i < ways; ++i)
+      hits += umon_hits[cpu][i];
+    return hits;
+  }
+
+  void partition(std::size_t num_way)
+  {
+    // every cpu keeps at least one way
+    std::array<uint32_t, NUM_CPUS> alloc;
+    alloc.fill(1);
+    std::size_t balance = num_way - std::min<std::size_t>(num_way, NUM_CPUS);
+
+    while (balance > 0) {
+      double best_mu = -1;
+      uint32_t best_cpu = 0, best_ways = 1;
+
+      for (uint32_t cpu = 0; cpu < NUM_CPUS; ++cpu) {
+        uint64_t base = utility(cpu, alloc[cpu]);
+        for (uint32_t extra = 1; extra <= balance && alloc[cpu] + extra <= num_way; ++extra) {
+          double mu = (1.0 * (utility(cpu, alloc[cpu] + extra) - base)) / extra;
+          if (mu > best_mu) {
+            best_mu = mu;
+            best_cpu = cpu;
+            best_ways = extra;
+          }
+        }
+      }
+
+      alloc[best_cpu] += best_ways;
+      balance -= best_ways;
+    }
+
+    quota = alloc;
+    for (auto& hits : umon_hits)
+      for (auto& h : hits)
+        h /= 2;
+    num_partitions++;
+  }
+};
+} // namespace
+
+void CACHE::initialize_replacement() { make_replacement_state<ucp_state>(NUM_SET, NUM_WAY); }
+
+// find replacement victim
+uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK* current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+{
+  auto& state = get_replacement_state<ucp_state>();
+
+  champsim::packed_ways::mask_type candidates = tags.owned_ways(set, cpu);
+  if (tags.owned_count(set, cpu) < state.quota[cpu] || candidates == 0) {
+    // take a way from a cpu over its quota, or failing that from any other cpu
+    champsim::packed_ways::mask_type over = 0, others = 0;
+    for (uint32_t other = 0; other < NUM_CPUS; ++other) {
+      if (other == cpu)
+        continue;
+      others |= tags.owned_ways(set, other);
+      if (tags.owned_count(set, other) > state.quota[other])
+        over |= tags.owned_ways(set, other);
+    }
+    candidates = over != 0 ? over : (others != 0 ? others : candidates);
+  }
+
+  return state.age.oldest(set, candidates != 0 ? candidates : state.age.all_ways());
+}
+
+// called on every cache hit and cache fill
+void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type,
+                                     uint8_t hit)
+{
+  auto& state = get_replacement_state<ucp_state>();
+
+  if (current_cycle >= state.next_partition) {
+    state.partition(NUM_WAY);
+    state.next_partition = current_cycle + PARTITION_INTERVAL;
+  }
+
+  if (type == WRITEBACK)
+    return;
+
+  if (uint16_t rank = state.umon_rank[set]; rank != 0)
+    state.monitor(cpu, rank - 1, full_addr >> OFFSET_BITS, NUM_WAY);
+
+  if (way < NUM_WAY)
+    state.age.promote(set, way);
+}
+
+// called once for every block that leaves the cache
+void CACHE::replacement_cache_evict(uint32_t set, uint32_t way, const BLOCK& evicted) {}
+
+void CACHE::replacement_final_stats()
+{
+  auto& state = get_replacement_state<ucp_state>();
+  std::cout << NAME << " UCP repartitions: " << state.num_partitions << std::endl;
+  for (uint32_t cpu = 0; cpu < NUM_CPUS; ++cpu)
+    std::cout << NAME << " UCP cpu" << cpu << " ways: " << state.quota[cpu] << std::endl;
+}
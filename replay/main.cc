@@ -0,0 +1,222 @@
+/*
+ *    Copyright 2023 The ChampSim Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/***
+ * Replays a captured access stream (see access_stream.h) through one cache of
+ * the configured system. Only the tags, blocks and replacement policy of that
+ * cache are modelled: every miss fills at once, the fills recorded in the
+ * stream are skipped, and no cores, queues, prefetchers or DRAM are simulated.
+ * Hit and miss counts are therefore those of the policy on that stream, not
+ * of a full timing run, which makes this a fast way to rank policies. The
+ * shadow replacement policies configured for that cache replay the same
+ * accesses, and their statistics are printed next to its own.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "access_stream.h"
+#include "cache.h"
+#include "champsim.h"
+#include "champsim_constants.h"
+#include "dram_controller.h"
+#include "ooo_cpu.h"
+#include "shadow_cache.h"
+
+uint8_t warmup_complete[NUM_CPUS] = {}, all_warmup_complete = 0, MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS;
+
+// For backwards compatibility with older module source.
+champsim::deprecated_clock_cycle current_core_cycle;
+
+extern std::array<CACHE*, NUM_CACHES> caches;
+
+namespace
+{
+CACHE* replayed = nullptr;
+}
+
+uint64_t champsim::deprecated_clock_cycle::operator[](std::size_t cpu_idx) { return replayed->current_cycle; }
+
+void reset_stats(CACHE& cache)
+{
+  for (uint32_t cpu = 0; cpu < NUM_CPUS; cpu++) {
+    for (uint32_t i = 0; i < NUM_TYPES; i++) {
+      cache.sim_access[cpu][i] = 0;
+      cache.sim_hit[cpu][i] = 0;
+      cache.sim_miss[cpu][i] = 0;
+    }
+  }
+
+  cache.pf_useful = 0;
+  cache.pf_useless = 0;
+  cache.pf_fill = 0;
+
+  if (cache.stack_distance)
+    cache.stack_distance->reset_stats();
+}
+
+// the shadow copies of a cache, once they have caught up with it
+std::vector<CACHE*> synced_shadows(CACHE& cache)
+{
+  if (!cache.shadows)
+    return {};
+
+  cache.shadows->sync();
+  return cache.shadows->caches();
+}
+
+void print_replay_stats(uint32_t cpu, const CACHE& cache)
+{
+  uint64_t TOTAL_ACCESS = 0, TOTAL_HIT = 0, TOTAL_MISS = 0;
+
+  for (uint32_t i = 0; i < NUM_TYPES; i++) {
+    TOTAL_ACCESS += cache.sim_access[cpu][i];
+    TOTAL_HIT += cache.sim_hit[cpu][i];
+    TOTAL_MISS += cache.sim_miss[cpu][i];
+  }
+
+  if (TOTAL_ACCESS == 0)
+    return;
+
+  const char* type_names[NUM_TYPES] = {" LOAD      ", " RFO       ", " PREFETCH  ", " WRITEBACK ", " TRANSLATION "};
+
+  std::cout << cache.NAME << " TOTAL     ACCESS: " << std::setw(10) << TOTAL_ACCESS << "  HIT: " << std::setw(10) << TOTAL_HIT << "  MISS: " << std::setw(10)
+            << TOTAL_MISS << "  MISS RATE: " << (1.0 * TOTAL_MISS) / TOTAL_ACCESS << std::endl;
+  for (uint32_t i = 0; i < NUM_TYPES; i++)
+    std::cout << cache.NAME << type_names[i] << "ACCESS: " << std::setw(10) << cache.sim_access[cpu][i] << "  HIT: " << std::setw(10) << cache.sim_hit[cpu][i]
+              << "  MISS: " << std::setw(10) << cache.sim_miss[cpu][i] << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  std::cout << std::endl << "*** ChampSim Cache Replay ***" << std::endl << std::endl;
+
+  std::string cache_name = "LLC";
+  uint64_t warmup_accesses = 0, simulation_accesses = 0;
+
+  static struct option long_options[] = {{"cache", required_argument, 0, 'c'},
+                                         {"warmup_accesses", required_argument, 0, 'w'},
+                                         {"simulation_accesses", required_argument, 0, 'i'},
+                                         {0, 0, 0, 0}};
+
+  int c;
+  while ((c = getopt_long_only(argc, argv, "c:w:i:", long_options, NULL)) != -1) {
+    switch (c) {
+    case 'c':
+      cache_name = optarg;
+      break;
+    case 'w':
+      warmup_accesses = atol(optarg);
+      break;
+    case 'i':
+      simulation_accesses = atol(optarg);
+      break;
+    default:
+      abort();
+    }
+  }
+
+  if (optind + 1 != argc) {
+    std::cout << "Usage: " << argv[0] << " [--cache NAME] [--warmup_accesses N] [--simulation_accesses N] <access stream>" << std::endl;
+    exit(1);
+  }
+
+  auto found = std::find_if(std::begin(caches), std::end(caches), [&](CACHE* x) { return x->NAME == cache_name; });
+  if (found == std::end(caches)) {
+    std::cerr << "No cache named " << cache_name << " in this configuration" << std::endl;
+    assert(0);
+  }
+  replayed = *found;
+  CACHE& cache = **found;
+
+  champsim::access_stream::reader stream{argv[optind]};
+
+  std::cout << "Warmup Accesses: " << warmup_accesses << std::endl;
+  std::cout << "Simulation Accesses: " << (simulation_accesses > 0 ? std::to_string(simulation_accesses) : "all") << std::endl;
+  std::cout << "Replaying " << argv[optind] << " (" << stream.size() << " records) through " << cache.NAME << " (" << cache.NUM_SET << " sets, "
+            << cache.NUM_WAY << " ways)" << std::endl
+            << std::endl;
+
+  cache.in_front_of_memory = dynamic_cast<MEMORY_CONTROLLER*>(cache.lower_level) != nullptr;
+  cache.impl_replacement_initialize();
+  if (!cache.shadow_repl.empty())
+    cache.shadows = std::make_shared<champsim::shadow_group>(cache);
+  if (cache.stack_distance_rate > 0)
+    cache.stack_distance = std::make_unique<champsim::stack_distance_profiler>(cache.NUM_SET, cache.NUM_WAY, cache.stack_distance_rate);
+
+  auto start_time = std::chrono::steady_clock::now();
+  uint64_t replayed_accesses = 0, end_access = (simulation_accesses > 0) ? warmup_accesses + simulation_accesses : UINT64_MAX;
+
+  for (std::size_t i = 0; i < stream.num_blocks() && replayed_accesses < end_access; ++i) {
+    for (auto dec = stream.decode(i); !dec.done() && replayed_accesses < end_access;) {
+      auto acc = dec.get();
+      if (acc.fill)
+        continue;
+
+      if (acc.cpu >= NUM_CPUS || acc.type >= NUM_TYPES) {
+        std::cerr << "Access stream record for cpu " << acc.cpu << " type " << +acc.type << " does not fit this configuration" << std::endl;
+        assert(0);
+      }
+
+      if (replayed_accesses == warmup_accesses && !all_warmup_complete) {
+        reset_stats(cache);
+        // shadow workers read warmup_complete too; synced_shadows lets them catch up before it changes
+        for (CACHE* shadow : synced_shadows(cache))
+          reset_stats(*shadow);
+        std::fill(std::begin(warmup_complete), std::end(warmup_complete), 1);
+        all_warmup_complete = 1;
+      }
+
+      cache.functional_access(acc);
+      if (cache.shadows)
+        cache.shadows->push(acc);
+      replayed_accesses++;
+    }
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+  std::cout << "Replayed " << replayed_accesses << " accesses in " << elapsed.count() << " seconds (" << replayed_accesses / elapsed.count() / 1e6
+            << " million accesses per second)" << std::endl;
+
+  if (replayed_accesses <= warmup_accesses) {
+    std::cout << "The stream ended during warmup" << std::endl;
+    return 0;
+  }
+
+  std::cout << std::endl << "Replay Statistics" << std::endl;
+  for (uint32_t i = 0; i < NUM_CPUS; i++) {
+    std::cout << std::endl << "CPU " << i << std::endl;
+    print_replay_stats(i, cache);
+    for (CACHE* shadow : synced_shadows(cache))
+      print_replay_stats(i, *shadow);
+  }
+  std::cout << std::endl;
+
+  cache.impl_replacement_final_stats();
+  for (CACHE* shadow : synced_shadows(cache))
+    shadow->impl_replacement_final_stats();
+  if (cache.stack_distance)
+    cache.stack_distance->print(cache.NAME);
+
+  return 0;
+}
@@ -22,6 +22,8 @@ output_dir=$4
 
 warmup_instructions=$1
 simulation_instructions=$2
+# traces are decompressed here on first use; override with TRACE_CACHE=dir
+trace_cache=${TRACE_CACHE:-trace_cache}
 
 for batch_size in 1 2 4 8; do
     echo "Configuring Batch: $batch_size"        
@@ -43,7 +45,7 @@ for batch_size in 1 2 4 8; do
             batch[$i]="$3/${batch[$i]}"
         done
         echo "--warmup_instructions  --simulation_instructions input file = ${batch[@]}  output file =  ${output_file} "
-        bin/champsim --warmup_instructions "$warmup_instructions" --simulation_instructions "$simulation_instructions" "${batch[@]}" > "$output_file"
+        bin/champsim --warmup_instructions "$warmup_instructions" --simulation_instructions "$simulation_instructions" --trace_cache "$trace_cache" "${batch[@]}" > "$output_file"
     done
     
     echo "Simulation Finished"
@@ -0,0 +1,162 @@
+/*
+ *    Copyright 2023 The ChampSim Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "access_stream.h"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace champsim::access_stream;
+
+namespace
+{
+file_header make_header(uint64_t num_records, uint64_t num_blocks, uint64_t index_offset)
+{
+  file_header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+  header.version = VERSION;
+  header.records_per_block = RECORDS_PER_BLOCK;
+  header.num_records = num_records;
+  header.num_blocks = num_blocks;
+  header.index_offset = index_offset;
+  return header;
+}
+
+void checked_write(FILE* fp, const void* data, std::size_t size, const std::string& path)
+{
+  if (size > 0 && fwrite(data, size, 1, fp) != 1) {
+    std::cerr << "Error writing access stream " << path << std::endl;
+    assert(0);
+  }
+}
+} // namespace
+
+writer::writer(std::string _path) : path(_path)
+{
+  fp = fopen(path.c_str(), "wb");
+  if (fp == NULL) {
+    std::cerr << "Could not open access stream " << path << " for writing" << std::endl;
+    assert(0);
+  }
+
+  // placeholder until the index is written
+  file_header header = make_header(0, 0, 0);
+  checked_write(fp, &header, sizeof(header), path);
+
+  io_thread = std::thread{&writer::run, this};
+}
+
+writer::~writer()
+{
+  if (!current.empty())
+    flush_block();
+
+  {
+    std::lock_guard<std::mutex> lock{mtx};
+    closing = true;
+  }
+  have_work.notify_one();
+  io_thread.join();
+
+  // align the index so a mapped reader can use it in place
+  const uint64_t padding[1] = {};
+  checked_write(fp, padding, -offset % alignof(block_info), path);
+  offset += -offset % alignof(block_info);
+  checked_write(fp, index.data(), index.size() * sizeof(block_info), path);
+
+  file_header header = make_header(num_records, index.size(), offset);
+  fseek(fp, 0, SEEK_SET);
+  checked_write(fp, &header, sizeof(header), path);
+  fclose(fp);
+}
+
+void writer::flush_block()
+{
+  pending_block blk{{}, current.start_cycle(), current.size()};
+  blk.bytes = current.take();
+
+  std::unique_lock<std::mutex> lock{mtx};
+  have_room.wait(lock, [this] { return pending.size() < MAX_PENDING; });
+  pending.push_back(std::move(blk));
+  lock.unlock();
+  have_work.notify_one();
+}
+
+void writer::run()
+{
+  std::unique_lock<std::mutex> lock{mtx};
+  while (true) {
+    have_work.wait(lock, [this] { return closing || !pending.empty(); });
+    if (pending.empty())
+      return; // closing, and everything has been written
+
+    pending_block blk = std::move(pending.front());
+    pending.pop_front();
+    lock.unlock();
+    have_room.notify_one();
+
+    checked_write(fp, blk.bytes.data(), blk.bytes.size(), path);
+    index.push_back({offset, num_records, blk.first_cycle, blk.num_records, static_cast<uint32_t>(blk.bytes.size())});
+    offset += blk.bytes.size();
+    num_records += blk.num_records;
+
+    lock.lock();
+  }
+}
+
+reader::reader(std::string path)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    std::cerr << "ACCESS STREAM NOT FOUND: " << path << std::endl;
+    assert(0);
+  }
+
+  length = static_cast<std::size_t>(st.st_size);
+  void* mapped = length < sizeof(file_header) ? MAP_FAILED : mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    std::cerr << "Could not map access stream " << path << std::endl;
+    assert(0);
+  }
+  madvise(mapped, length, MADV_SEQUENTIAL);
+
+  base = static_cast<const uint8_t*>(mapped);
+  header = reinterpret_cast<const file_header*>(base);
+  if (std::memcmp(header->magic, MAGIC, sizeof(header->magic)) != 0 || header->version != VERSION) {
+    std::cerr << path << " is not an access stream" << std::endl;
+    assert(0);
+  }
+  if (header->index_offset == 0 || header->index_offset % alignof(block_info) != 0 || header->index_offset + header->num_blocks * sizeof(block_info) > length) {
+    std::cerr << "Access stream " << path << " is incomplete" << std::endl;
+    assert(0);
+  }
+
+  index = reinterpret_cast<const block_info*>(base + header->index_offset);
+}
+
+reader::~reader()
+{
+  if (base != nullptr)
+    munmap(const_cast<uint8_t*>(base), length);
+}
@@ -21,6 +21,7 @@
 
 #include "champsim.h"
 #include "champsim_constants.h"
+#include "shadow_cache.h"
 #include "util.h"
 #include "vmem.h"
 
@@ -41,10 +42,7 @@ void CACHE::handle_fill()
     // find victim
     uint32_t set = get_set(fill_mshr->address);
 
-    auto set_begin = std::next(std::begin(block), set * NUM_WAY);
-    auto set_end = std::next(set_begin, NUM_WAY);
-    auto first_inv = std::find_if_not(set_begin, set_end, is_valid<BLOCK>());
-    uint32_t way = std::distance(set_begin, first_inv);
+    uint32_t way = tags.first_invalid(set);
     if (way == NUM_WAY)
       way = impl_replacement_find_victim(fill_mshr->cpu, fill_mshr->instr_id, set, &block.data()[set * NUM_WAY], fill_mshr->ip, fill_mshr->address,
                                          fill_mshr->type);
@@ -53,14 +51,14 @@ void CACHE::handle_fill()
     if (!success)
       return;
 
-    if (way != NUM_WAY) {
-      // update processed packets
+    // update processed packets; a bypassed fill passes its own data on
+    if (way != NUM_WAY)
       fill_mshr->data = block[set * NUM_WAY + way].data;
 
-      for (auto ret : fill_mshr->to_return)
-        ret->return_data(&(*fill_mshr));
-    }
+    for (auto ret : fill_mshr->to_return)
+      ret->return_data(&(*fill_mshr));
 
+    record_access(*fill_mshr, false, true);
     MSHR.erase(fill_mshr);
     writes_available_this_cycle--;
   }
@@ -80,8 +78,9 @@ void CACHE::handle_writeback()
     uint32_t way = get_way(handle_pkt.address, set);
 
     BLOCK& fill_block = block[set * NUM_WAY + way];
+    bool hit = (way < NUM_WAY);
 
-    if (way < NUM_WAY) // HIT
+    if (hit) // HIT
     {
       impl_replacement_update_state(handle_pkt.cpu, set, way, fill_block.address, handle_pkt.ip, 0, handle_pkt.type, 1);
 
@@ -98,10 +97,7 @@ void CACHE::handle_writeback()
         success = readlike_miss(handle_pkt);
       } else {
         // find victim
-        auto set_begin = std::next(std::begin(block), set * NUM_WAY);
-        auto set_end = std::next(set_begin, NUM_WAY);
-        auto first_inv = std::find_if_not(set_begin, set_end, is_valid<BLOCK>());
-        way = std::distance(set_begin, first_inv);
+        way = tags.first_invalid(set);
         if (way == NUM_WAY)
           way = impl_replacement_find_victim(handle_pkt.cpu, handle_pkt.instr_id, set, &block.data()[set * NUM_WAY], handle_pkt.ip, handle_pkt.address,
                                              handle_pkt.type);
@@ -113,6 +109,8 @@ void CACHE::handle_writeback()
         return;
     }
 
+    record_access(handle_pkt, hit, false);
+
     // remove this entry from WQ
     writes_available_this_cycle--;
     WQ.pop_front();
@@ -145,6 +143,8 @@ void CACHE::handle_read()
         return;
     }
 
+    record_access(handle_pkt, way < NUM_WAY, false);
+
     // remove this entry from RQ
     RQ.pop_front();
     reads_available_this_cycle--;
@@ -172,6 +172,8 @@ void CACHE::handle_prefetch()
         return;
     }
 
+    record_access(handle_pkt, way < NUM_WAY, false);
+
     // remove this entry from PQ
     PQ.pop_front();
     reads_available_this_cycle--;
@@ -217,6 +219,95 @@ void CACHE::readlike_hit(std::size_t set, std::size_t way, PACKET& handle_pkt)
   }
 }
 
+void CACHE::record_access(const PACKET& handle_pkt, bool hit, bool fill)
+{
+  if (!capture && !shadows && !stack_distance)
+    return;
+
+  champsim::access_stream::access acc;
+  acc.cycle = current_cycle;
+  acc.address = handle_pkt.address;
+  acc.ip = handle_pkt.ip;
+  acc.cpu = handle_pkt.cpu;
+  acc.type = handle_pkt.type;
+  acc.hit = hit;
+  acc.fill = fill;
+
+  if (capture)
+    capture->push(acc);
+
+  // the copies fill their own misses at once
+  if (shadows && !fill)
+    shadows->push(acc);
+
+  if (stack_distance && !fill)
+    stack_distance->access(acc.cpu, acc.address >> OFFSET_BITS, get_set(acc.address));
+}
+
+// Handle one access with no timing: a miss fills at once, with no MSHR, queue
+// or lower level involved. Used to replay access streams and by shadow copies.
+void CACHE::functional_access(const champsim::access_stream::access& acc)
+{
+  current_cycle = acc.cycle;
+
+  uint32_t set = get_set(acc.address);
+  uint32_t way = get_way(acc.address, set);
+
+  if (stack_distance)
+    stack_distance->access(acc.cpu, acc.address >> OFFSET_BITS, set);
+
+  sim_access[acc.cpu][acc.type]++;
+
+  if (way < NUM_WAY) // HIT
+  {
+    BLOCK& hit_block = block[set * NUM_WAY + way];
+    impl_replacement_update_state(acc.cpu, set, way, hit_block.address, acc.ip, 0, acc.type, 1);
+    sim_hit[acc.cpu][acc.type]++;
+
+    if (acc.type == WRITEBACK) {
+      hit_block.dirty = true;
+    } else if (hit_block.prefetch) {
+      pf_useful++;
+      hit_block.prefetch = false;
+    }
+    return;
+  }
+
+  // MISS: fill right away
+  sim_miss[acc.cpu][acc.type]++;
+
+  way = tags.first_invalid(set);
+  if (way == NUM_WAY)
+    way = impl_replacement_find_victim(acc.cpu, 0, set, &block[set * NUM_WAY], acc.ip, acc.address, acc.type);
+
+  uint64_t victim_address = 0;
+  if (way < NUM_WAY) {
+    BLOCK& fill_block = block[set * NUM_WAY + way];
+    if (fill_block.valid) {
+      victim_address = fill_block.address;
+      impl_replacement_cache_evict(set, way, fill_block);
+    }
+
+    if (fill_block.prefetch)
+      pf_useless++;
+    if (acc.type == PREFETCH)
+      pf_fill++;
+
+    tags.fill(set, way, acc.address >> OFFSET_BITS, acc.cpu);
+    fill_block.valid = true;
+    fill_block.prefetch = (acc.type == PREFETCH);
+    fill_block.dirty = (acc.type == WRITEBACK);
+    fill_block.address = acc.address;
+    fill_block.v_address = acc.address;
+    fill_block.ip = acc.ip;
+    fill_block.cpu = acc.cpu;
+    fill_block.instr_id = 0;
+    fill_block.fill_cycle = acc.cycle;
+  }
+
+  impl_replacement_update_state(acc.cpu, set, way, acc.address, acc.ip, victim_address, acc.type, 0);
+}
+
 bool CACHE::readlike_miss(PACKET& handle_pkt)
 {
   DP(if (warmup_complete[handle_pkt.cpu]) {
@@ -312,7 +403,7 @@ bool CACHE::filllike_miss(std::size_t set, std::size_t way, PACKET& handle_pkt)
 
   BLOCK& fill_block = block[set * NUM_WAY + way];
   bool evicting_dirty = !bypass && (lower_level != NULL) && fill_block.dirty;
-  uint64_t evicting_address = 0;
+  uint64_t evicting_address = 0, victim_address = 0;
 
   if (!bypass) {
     if (evicting_dirty) {
@@ -336,12 +427,19 @@ bool CACHE::filllike_miss(std::size_t set, std::size_t way, PACKET& handle_pkt)
     else
       evicting_address = fill_block.v_address & ~bitmask(match_offset_bits ? 0 : OFFSET_BITS);
 
+    // the fill can no longer fail, so the old block is really leaving
+    if (fill_block.valid) {
+      victim_address = fill_block.address;
+      impl_replacement_cache_evict(set, way, fill_block);
+    }
+
     if (fill_block.prefetch)
       pf_useless++;
 
     if (handle_pkt.type == PREFETCH)
       pf_fill++;
 
+    tags.fill(set, way, handle_pkt.address >> OFFSET_BITS, handle_pkt.cpu);
     fill_block.valid = true;
     fill_block.prefetch = (handle_pkt.type == PREFETCH && handle_pkt.pf_origin_level == fill_level);
     fill_block.dirty = (handle_pkt.type == WRITEBACK || (handle_pkt.type == RFO && handle_pkt.to_return.empty()));
@@ -351,6 +449,7 @@ bool CACHE::filllike_miss(std::size_t set, std::size_t way, PACKET& handle_pkt)
     fill_block.ip = handle_pkt.ip;
     fill_block.cpu = handle_pkt.cpu;
     fill_block.instr_id = handle_pkt.instr_id;
+    fill_block.fill_cycle = current_cycle;
   }
 
   if (warmup_complete[handle_pkt.cpu] && (handle_pkt.cycle_enqueued != 0))
@@ -363,7 +462,7 @@ bool CACHE::filllike_miss(std::size_t set, std::size_t way, PACKET& handle_pkt)
                                  handle_pkt.type == PREFETCH, evicting_address, handle_pkt.pf_metadata);
 
   // update replacement policy
-  impl_replacement_update_state(handle_pkt.cpu, set, way, handle_pkt.address, handle_pkt.ip, 0, handle_pkt.type, 0);
+  impl_replacement_update_state(handle_pkt.cpu, set, way, handle_pkt.address, handle_pkt.ip, victim_address, handle_pkt.type, 0);
 
   // COLLECT STATS
   sim_miss[handle_pkt.cpu][handle_pkt.type]++;
@@ -405,20 +504,18 @@ void CACHE::operate_reads()
 
 uint32_t CACHE::get_set(uint64_t address) { return ((address >> OFFSET_BITS) & bitmask(lg2(NUM_SET))); }
 
-uint32_t CACHE::get_way(uint64_t address, uint32_t set)
-{
-  auto begin = std::next(block.begin(), set * NUM_WAY);
-  auto end = std::next(begin, NUM_WAY);
-  return std::distance(begin, std::find_if(begin, end, eq_addr<BLOCK>(address, OFFSET_BITS)));
-}
+uint32_t CACHE::get_way(uint64_t address, uint32_t set) { return tags.find(set, address >> OFFSET_BITS); }
 
 int CACHE::invalidate_entry(uint64_t inval_addr)
 {
   uint32_t set = get_set(inval_addr);
   uint32_t way = get_way(inval_addr, set);
 
-  if (way < NUM_WAY)
+  if (way < NUM_WAY) {
+    impl_replacement_cache_evict(set, way, block[set * NUM_WAY + way]);
+    tags.invalidate(set, way);
     block[set * NUM_WAY + way].valid = 0;
+  }
 
   return way;
 }
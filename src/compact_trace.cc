@@ -0,0 +1,161 @@
+/*
+ *    Copyright 2023 The ChampSim Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compact_trace.h"
+
+#include <cassert>
+#include <cstring>
+
+using namespace champsim::compact_trace;
+
+namespace
+{
+constexpr unsigned IS_BRANCH = 1 << 0, BRANCH_TAKEN = 1 << 1, FIRST_MEMORY_BIT = 2;
+
+void put_varint(uint64_t value, std::vector<uint8_t>& out)
+{
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+void put_delta(uint64_t value, uint64_t& last, std::vector<uint8_t>& out)
+{
+  auto delta = static_cast<int64_t>(value - last);
+  put_varint((static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63), out);
+  last = value;
+}
+
+bool get_varint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+{
+  value = 0;
+  for (unsigned shift = 0; shift < 64 && in != end; shift += 7) {
+    uint8_t byte = *in++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool get_delta(const uint8_t*& in, const uint8_t* end, uint64_t& last)
+{
+  uint64_t zigzag;
+  if (!get_varint(in, end, zigzag))
+    return false;
+  last += (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+  return true;
+}
+} // namespace
+
+void champsim::compact_trace::encode_block(const input_instr* begin, const input_instr* end, std::vector<uint8_t>& out)
+{
+  assert(end - begin <= static_cast<std::ptrdiff_t>(BLOCK_RECORDS));
+
+  std::size_t header_at = out.size();
+  out.resize(header_at + sizeof(block_header));
+
+  uint64_t last_ip = 0, last_address = 0;
+  for (auto instr = begin; instr != end; ++instr) {
+    assert(instr->is_branch <= 1 && instr->branch_taken <= 1);
+
+    uint8_t flags = (instr->is_branch ? IS_BRANCH : 0) | (instr->branch_taken ? BRANCH_TAKEN : 0);
+    unsigned bit = FIRST_MEMORY_BIT;
+    for (auto address : instr->destination_memory)
+      flags |= (address != 0) << bit++;
+    for (auto address : instr->source_memory)
+      flags |= (address != 0) << bit++;
+
+    uint8_t registers = 0;
+    bit = 0;
+    for (auto reg : instr->destination_registers)
+      registers |= (reg != 0) << bit++;
+    for (auto reg : instr->source_registers)
+      registers |= (reg != 0) << bit++;
+
+    out.push_back(flags);
+    out.push_back(registers);
+    put_delta(instr->ip, last_ip, out);
+
+    for (auto reg : instr->destination_registers)
+      if (reg != 0)
+        out.push_back(reg);
+    for (auto reg : instr->source_registers)
+      if (reg != 0)
+        out.push_back(reg);
+
+    for (auto address : instr->destination_memory)
+      if (address != 0)
+        put_delta(address, last_address, out);
+    for (auto address : instr->source_memory)
+      if (address != 0)
+        put_delta(address, last_address, out);
+  }
+
+  block_header header{static_cast<uint32_t>(end - begin), static_cast<uint32_t>(out.size() - header_at - sizeof(block_header))};
+  std::memcpy(out.data() + header_at, &header, sizeof(header));
+}
+
+bool champsim::compact_trace::decode_block(const block_header& header, const uint8_t* in, input_instr* out)
+{
+  const uint8_t* end = in + header.bytes;
+  uint64_t last_ip = 0, last_address = 0;
+
+  for (auto instr = out; instr != out + header.records; ++instr) {
+    if (end - in < 2)
+      return false;
+    uint8_t flags = *in++;
+    uint8_t registers = *in++;
+
+    *instr = {};
+    instr->is_branch = (flags & IS_BRANCH) != 0;
+    instr->branch_taken = (flags & BRANCH_TAKEN) != 0;
+
+    if (!get_delta(in, end, last_ip))
+      return false;
+    instr->ip = last_ip;
+
+    if (end - in < __builtin_popcount(registers))
+      return false;
+    unsigned bit = 0;
+    for (auto& reg : instr->destination_registers)
+      if (registers & (1 << bit++))
+        reg = *in++;
+    for (auto& reg : instr->source_registers)
+      if (registers & (1 << bit++))
+        reg = *in++;
+
+    bit = FIRST_MEMORY_BIT;
+    auto get_address = [&](auto& address) {
+      if (!(flags & (1 << bit++)))
+        return true;
+      if (!get_delta(in, end, last_address))
+        return false;
+      address = last_address;
+      return true;
+    };
+    for (auto& address : instr->destination_memory)
+      if (!get_address(address))
+        return false;
+    for (auto& address : instr->source_memory)
+      if (!get_address(address))
+        return false;
+  }
+
+  return in == end;
+}
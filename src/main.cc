@@ -30,6 +30,7 @@
 #include "dram_controller.h"
 #include "ooo_cpu.h"
 #include "operable.h"
+#include "shadow_cache.h"
 #include "tracereader.h"
 #include "vmem.h"
 
@@ -149,6 +150,53 @@ void print_sim_stats(uint32_t cpu, CACHE* cache)
   }
 }
 
+// the shadow copies of a cache, once they have caught up with it
+std::vector<CACHE*> synced_shadows(CACHE* cache)
+{
+  if (!cache->shadows)
+    return {};
+
+  cache->shadows->sync();
+  return cache->shadows->caches();
+}
+
+void print_shadow_stats(uint32_t cpu, CACHE* cache)
+{
+  std::vector<CACHE*> compared{cache};
+  for (CACHE* shadow : synced_shadows(cache))
+    compared.push_back(shadow);
+
+  for (CACHE* c : compared) {
+    uint64_t TOTAL_ACCESS = 0, TOTAL_HIT = 0, TOTAL_MISS = 0;
+
+    for (uint32_t i = 0; i < NUM_TYPES; i++) {
+      TOTAL_ACCESS += c->roi_access[cpu][i];
+      TOTAL_HIT += c->roi_hit[cpu][i];
+      TOTAL_MISS += c->roi_miss[cpu][i];
+    }
+
+    cout << c->NAME;
+    cout << " TOTAL     ACCESS: " << setw(10) << TOTAL_ACCESS << "  HIT: " << setw(10) << TOTAL_HIT << "  MISS: " << setw(10) << TOTAL_MISS;
+    cout << "  MPKI: " << (1000.0 * TOTAL_MISS) / ooo_cpu[cpu]->finish_sim_instr << endl;
+
+    cout << c->NAME;
+    cout << " LOAD      ACCESS: " << setw(10) << c->roi_access[cpu][0] << "  HIT: " << setw(10) << c->roi_hit[cpu][0] << "  MISS: " << setw(10)
+         << c->roi_miss[cpu][0] << endl;
+
+    cout << c->NAME;
+    cout << " RFO       ACCESS: " << setw(10) << c->roi_access[cpu][1] << "  HIT: " << setw(10) << c->roi_hit[cpu][1] << "  MISS: " << setw(10)
+         << c->roi_miss[cpu][1] << endl;
+
+    cout << c->NAME;
+    cout << " PREFETCH  ACCESS: " << setw(10) << c->roi_access[cpu][2] << "  HIT: " << setw(10) << c->roi_hit[cpu][2] << "  MISS: " << setw(10)
+         << c->roi_miss[cpu][2] << endl;
+
+    cout << c->NAME;
+    cout << " WRITEBACK ACCESS: " << setw(10) << c->roi_access[cpu][3] << "  HIT: " << setw(10) << c->roi_hit[cpu][3] << "  MISS: " << setw(10)
+         << c->roi_miss[cpu][3] << endl;
+  }
+}
+
 void print_branch_stats()
 {
   for (uint32_t i = 0; i < NUM_CPUS; i++) {
@@ -299,11 +347,18 @@ void finish_warmup()
       ooo_cpu[i]->branch_type_misses[j] = 0;
     }
 
-    for (auto it = caches.rbegin(); it != caches.rend(); ++it)
+    for (auto it = caches.rbegin(); it != caches.rend(); ++it) {
       reset_cache_stats(i, *it);
+      for (CACHE* shadow : synced_shadows(*it))
+        reset_cache_stats(i, shadow);
+    }
   }
   cout << endl;
 
+  for (CACHE* cache : caches)
+    if (cache->stack_distance)
+      cache->stack_distance->reset_stats();
+
   // reset DRAM stats
   for (uint32_t i = 0; i < DRAM_CHANNELS; i++) {
     DRAM.channels[i].WQ_ROW_BUFFER_HIT = 0;
@@ -332,6 +387,8 @@ int main(int argc, char** argv)
 
   // initialize knobs
   uint8_t show_heartbeat = 1;
+  std::string trace_cache_dir;
+  uint64_t skip_instructions = 0;
 
   // check to see if knobs changed using getopt_long()
   int traces_encountered = 0;
@@ -339,11 +396,13 @@ int main(int argc, char** argv)
                                          {"simulation_instructions", required_argument, 0, 'i'},
                                          {"hide_heartbeat", no_argument, 0, 'h'},
                                          {"cloudsuite", no_argument, 0, 'c'},
+                                         {"trace_cache", required_argument, 0, 'd'},
+                                         {"skip_instructions", required_argument, 0, 's'},
                                          {"traces", no_argument, &traces_encountered, 1},
                                          {0, 0, 0, 0}};
 
   int c;
-  while ((c = getopt_long_only(argc, argv, "w:i:hc", long_options, NULL)) != -1 && !traces_encountered) {
+  while ((c = getopt_long_only(argc, argv, "w:i:hcd:s:", long_options, NULL)) != -1 && !traces_encountered) {
     switch (c) {
     case 'w':
       warmup_instructions = atol(optarg);
@@ -358,6 +417,12 @@ int main(int argc, char** argv)
       knob_cloudsuite = 1;
       MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS_SPARC;
       break;
+    case 'd':
+      trace_cache_dir = optarg;
+      break;
+    case 's':
+      skip_instructions = atol(optarg);
+      break;
     case 0:
       break;
     default:
@@ -365,6 +430,7 @@ int main(int argc, char** argv)
     }
   }
 
+  cout << "Skip Instructions: " << skip_instructions << endl;
   cout << "Warmup Instructions: " << warmup_instructions << endl;
   cout << "Simulation Instructions: " << simulation_instructions << endl;
   cout << "Number of CPUs: " << NUM_CPUS << endl;
@@ -386,7 +452,7 @@ int main(int argc, char** argv)
   for (int i = optind; i < argc; i++) {
     std::cout << "CPU " << traces.size() << " runs " << argv[i] << std::endl;
 
-    traces.push_back(get_tracereader(argv[i], traces.size(), knob_cloudsuite));
+    traces.push_back(get_tracereader(argv[i], traces.size(), knob_cloudsuite, trace_cache_dir, skip_instructions));
 
     if (traces.size() > NUM_CPUS) {
       printf("\n*** Too many traces for the configured number of cores ***\n\n");
@@ -406,8 +472,18 @@ int main(int argc, char** argv)
   }
 
   for (auto it = caches.rbegin(); it != caches.rend(); ++it) {
+    (*it)->in_front_of_memory = dynamic_cast<MEMORY_CONTROLLER*>((*it)->lower_level) != nullptr;
     (*it)->impl_prefetcher_initialize();
     (*it)->impl_replacement_initialize();
+
+    if (!(*it)->capture_file.empty())
+      (*it)->capture = std::make_unique<champsim::access_stream::writer>((*it)->capture_file);
+
+    if (!(*it)->shadow_repl.empty())
+      (*it)->shadows = std::make_shared<champsim::shadow_group>(**it);
+
+    if ((*it)->stack_distance_rate > 0)
+      (*it)->stack_distance = std::make_unique<champsim::stack_distance_profiler>((*it)->NUM_SET, (*it)->NUM_WAY, (*it)->stack_distance_rate);
   }
 
   // simulation entry point
@@ -452,6 +528,11 @@ int main(int argc, char** argv)
         cout << "Heartbeat CPU " << i << " instructions: " << ooo_cpu[i]->num_retired << " cycles: " << ooo_cpu[i]->current_cycle;
         cout << " heartbeat IPC: " << heartbeat_ipc << " cumulative IPC: " << cumulative_ipc;
         cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute << " min " << elapsed_second << " sec) " << endl;
+
+        // share of the last-level cache this cpu's blocks hold, to follow how co-runners divide it
+        CACHE* llc = caches.front();
+        cout << "Heartbeat CPU " << i << " cycles: " << ooo_cpu[i]->current_cycle << " " << llc->NAME << " occupancy: " << llc->tags.occupancy(i)
+             << " blocks (" << (100.0 * llc->tags.occupancy(i)) / (llc->NUM_SET * llc->NUM_WAY) << "%)" << endl;
         ooo_cpu[i]->next_print_instruction += STAT_PRINTING_PERIOD;
 
         ooo_cpu[i]->last_sim_instr = ooo_cpu[i]->num_retired;
@@ -461,6 +542,9 @@ int main(int argc, char** argv)
       // check for warmup
       // warmup complete
       if ((warmup_complete[i] == 0) && (ooo_cpu[i]->num_retired > warmup_instructions)) {
+        // shadow workers read warmup_complete too; let them catch up so they see it change at the same access as their cache
+        for (CACHE* cache : caches)
+          synced_shadows(cache);
         warmup_complete[i] = 1;
         all_warmup_complete++;
       }
@@ -481,8 +565,11 @@ int main(int argc, char** argv)
         cout << " cumulative IPC: " << ((float)ooo_cpu[i]->finish_sim_instr / ooo_cpu[i]->finish_sim_cycle);
         cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute << " min " << elapsed_second << " sec) " << endl;
 
-        for (auto it = caches.rbegin(); it != caches.rend(); ++it)
+        for (auto it = caches.rbegin(); it != caches.rend(); ++it) {
           record_roi_stats(i, *it);
+          for (CACHE* shadow : synced_shadows(*it))
+            record_roi_stats(i, shadow);
+        }
       }
     }
   }
@@ -513,11 +600,28 @@ int main(int argc, char** argv)
       print_roi_stats(i, *it);
   }
 
+  if (std::any_of(std::begin(caches), std::end(caches), [](CACHE* c) { return c->shadows != nullptr; })) {
+    cout << endl << "Shadow Replacement Policy Statistics" << endl;
+    for (uint32_t i = 0; i < NUM_CPUS; i++) {
+      cout << endl << "CPU " << i << " instructions: " << ooo_cpu[i]->finish_sim_instr << endl;
+      for (auto it = caches.rbegin(); it != caches.rend(); ++it)
+        if ((*it)->shadows)
+          print_shadow_stats(i, *it);
+    }
+  }
+
   for (auto it = caches.rbegin(); it != caches.rend(); ++it)
     (*it)->impl_prefetcher_final_stats();
 
-  for (auto it = caches.rbegin(); it != caches.rend(); ++it)
+  for (auto it = caches.rbegin(); it != caches.rend(); ++it) {
     (*it)->impl_replacement_final_stats();
+    for (CACHE* shadow : synced_shadows(*it))
+      shadow->impl_replacement_final_stats();
+  }
+
+  for (auto it = caches.rbegin(); it != caches.rend(); ++it)
+    if ((*it)->stack_distance)
+      (*it)->stack_distance->print((*it)->NAME);
 
 #ifndef CRC2_COMPILE
   print_dram_stats();
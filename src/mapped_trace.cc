@@ -0,0 +1,132 @@
+/*
+ *    Copyright 2023 The ChampSim Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mapped_trace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace_decoder.h"
+
+using namespace champsim;
+
+namespace
+{
+// 64-bit hash of the compressed trace, eight bytes at a time
+uint64_t content_hash(const std::string& path)
+{
+  constexpr std::size_t BLOCK_BYTES = 1 << 20;
+  constexpr uint64_t PRIME = 0x100000001b3;
+
+  FILE* fp = std::fopen(path.c_str(), "rb");
+  if (fp == nullptr) {
+    std::cerr << std::endl << "*** CANNOT OPEN TRACE FILE: " << path << " ***" << std::endl;
+    assert(0);
+  }
+
+  auto buf = std::make_unique<uint8_t[]>(BLOCK_BYTES);
+  uint64_t hash = 0xcbf29ce484222325, total = 0;
+  std::size_t n;
+  while ((n = std::fread(buf.get(), 1, BLOCK_BYTES, fp)) > 0) {
+    for (std::size_t i = 0; i < n; i += sizeof(uint64_t)) {
+      uint64_t word = 0;
+      std::memcpy(&word, buf.get() + i, std::min(sizeof(uint64_t), n - i));
+      hash = (hash ^ word) * PRIME;
+      hash ^= hash >> 29;
+    }
+    total += n;
+  }
+  std::fclose(fp);
+
+  return (hash ^ total) * PRIME;
+}
+
+// decompress the trace into the cache file, through a file of our own so that concurrent runs never see it half-written
+void expand(const std::string& path, std::size_t record_size, const std::string& cache_file)
+{
+  std::cout << "*** Expanding trace " << path << " into " << cache_file << std::endl;
+
+  std::string partial = cache_file + ".part" + std::to_string(getpid());
+  FILE* out = std::fopen(partial.c_str(), "wb");
+  if (out == nullptr) {
+    std::cerr << std::endl << "*** CANNOT WRITE TRACE CACHE FILE: " << partial << " ***" << std::endl;
+    assert(0);
+  }
+
+  trace_decoder decoder{path, record_size};
+  std::size_t reader = decoder.attach();
+  bool end_of_trace = false;
+  for (uint64_t index = 0; !end_of_trace; ++index) {
+    auto c = decoder.get(reader, index);
+    if (std::fwrite(c->data.get(), 1, c->size, out) != c->size) {
+      std::cerr << std::endl << "*** CANNOT WRITE TRACE CACHE FILE: " << partial << " ***" << std::endl;
+      assert(0);
+    }
+    end_of_trace = c->end_of_trace;
+  }
+
+  std::fclose(out);
+  std::filesystem::rename(partial, cache_file);
+}
+} // namespace
+
+mapped_trace::mapped_trace(std::string path, std::size_t record_size, std::string cache_dir)
+{
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << content_hash(path) << std::dec << "-" << record_size << ".champsimtrace";
+  std::string cache_file = (std::filesystem::path{cache_dir} / name.str()).string();
+
+  std::filesystem::create_directories(cache_dir);
+  if (!std::filesystem::exists(cache_file))
+    expand(path, record_size, cache_file);
+
+  int fd = ::open(cache_file.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    std::cerr << std::endl << "*** CANNOT OPEN TRACE CACHE FILE: " << cache_file << " ***" << std::endl;
+    assert(0);
+  }
+
+  length = static_cast<std::size_t>(st.st_size);
+  if (length == 0 || length % record_size != 0) {
+    std::cerr << "*** TRACE CACHE FILE IS NOT WHOLE RECORDS: " << cache_file << " ***" << std::endl;
+    assert(0);
+  }
+
+  void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << std::endl << "*** CANNOT MAP TRACE CACHE FILE: " << cache_file << " ***" << std::endl;
+    assert(0);
+  }
+
+  madvise(addr, length, MADV_SEQUENTIAL);
+  base = static_cast<const uint8_t*>(addr);
+}
+
+mapped_trace::~mapped_trace() { munmap(const_cast<uint8_t*>(base), length); }
@@ -0,0 +1,110 @@
+/*
+ *    Copyright 2023 The ChampSim Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shadow_cache.h"
+
+#include <algorithm>
+
+using namespace champsim;
+
+shadow_group::shadow::shadow(const CACHE& owner, CACHE::repl_t repl, const std::string& repl_name)
+    : cache(owner.NAME + "_" + repl_name, owner.CLOCK_SCALE, owner.fill_level, owner.NUM_SET, owner.NUM_WAY, 0, 0, 0, 0, owner.HIT_LATENCY,
+            owner.FILL_LATENCY, 0, 0, owner.OFFSET_BITS, owner.prefetch_as_load, owner.match_offset_bits, owner.virtual_prefetch, owner.pref_activate_mask,
+            nullptr, owner.pref_type, repl, "", {}, 0, owner.ebis_filter, owner.prefetch_aware_repl)
+{
+  cache.cpu = owner.cpu;
+  cache.in_front_of_memory = owner.in_front_of_memory; // the copy has no lower level of its own
+}
+
+shadow_group::shadow_group(const CACHE& owner)
+{
+  current.reserve(BATCH_SIZE);
+
+  for (const auto& [repl, repl_name] : owner.shadow_repl) {
+    shadows.push_back(std::make_unique<shadow>(owner, repl, repl_name));
+    shadows.back()->cache.impl_replacement_initialize();
+  }
+
+  // start the workers only once every copy is initialized
+  for (auto& s : shadows)
+    s->worker = std::thread{&shadow_group::run, this, std::ref(*s)};
+}
+
+shadow_group::~shadow_group()
+{
+  sync();
+
+  {
+    std::lock_guard<std::mutex> lock{mtx};
+    closing = true;
+  }
+  have_work.notify_all();
+  for (auto& s : shadows)
+    s->worker.join();
+}
+
+void shadow_group::flush_batch()
+{
+  auto full = std::make_shared<const batch>(std::move(current));
+  current = batch{};
+  current.reserve(BATCH_SIZE);
+
+  std::unique_lock<std::mutex> lock{mtx};
+  have_room.wait(lock, [this] { return std::all_of(std::begin(shadows), std::end(shadows), [](auto& s) { return s->pending.size() < MAX_PENDING; }); });
+  for (auto& s : shadows)
+    s->pending.push_back(full);
+  lock.unlock();
+  have_work.notify_all();
+}
+
+void shadow_group::sync()
+{
+  if (!current.empty())
+    flush_batch();
+
+  std::unique_lock<std::mutex> lock{mtx};
+  have_room.wait(lock, [this] { return std::all_of(std::begin(shadows), std::end(shadows), [](auto& s) { return s->pending.empty() && !s->busy; }); });
+}
+
+void shadow_group::run(shadow& s)
+{
+  std::unique_lock<std::mutex> lock{mtx};
+  while (true) {
+    have_work.wait(lock, [&] { return closing || !s.pending.empty(); });
+    if (s.pending.empty())
+      return; // closing, and everything has been replayed
+
+    auto next = std::move(s.pending.front());
+    s.pending.pop_front();
+    s.busy = true;
+    lock.unlock();
+
+    for (const auto& acc : *next)
+      s.cache.functional_access(acc);
+
+    lock.lock();
+    s.busy = false;
+    have_room.notify_all();
+  }
+}
+
+std::vector<CACHE*> shadow_group::caches() const
+{
+  std::vector<CACHE*> result;
+  for (auto& s : shadows)
+    result.push_back(&s->cache);
+  return result;
+}
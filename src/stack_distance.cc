@@ -0,0 +1,197 @@
+/*
+ *    Copyright 2023 The ChampSim Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stack_distance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+
+using namespace champsim;
+
+namespace
+{
+constexpr std::size_t INITIAL_TIMELINE = 1 << 16;
+
+// number of bits needed to hold val, i.e. the distance bucket
+unsigned bucket_of(uint64_t val) { return val == 0 ? 0 : 64 - __builtin_clzll(val); }
+
+std::size_t num_sampled_sets(std::size_t num_set, double rate) { return std::clamp<std::size_t>(std::lround(rate * num_set), 1, num_set); }
+} // namespace
+
+stack_distance_profile::stack_distance_profile(std::size_t num_sampled_sets, std::size_t depth)
+    : tree(INITIAL_TIMELINE + 1), depth(depth), set_stacks(num_sampled_sets * depth), set_used(num_sampled_sets), way_hist(depth + 1)
+{
+}
+
+void stack_distance_profile::mark(uint64_t time, int32_t delta)
+{
+  for (uint64_t i = time + 1; i < std::size(tree); i += i & (0 - i))
+    tree[i] += delta;
+}
+
+uint64_t stack_distance_profile::marked_after(uint64_t time) const
+{
+  uint64_t marked_up_to = 0;
+  for (uint64_t i = time + 1; i > 0; i -= i & (0 - i))
+    marked_up_to += tree[i];
+  return std::size(last_access) - marked_up_to;
+}
+
+void stack_distance_profile::compact()
+{
+  std::vector<std::pair<uint64_t, uint64_t>> live; // (time, block)
+  live.reserve(std::size(last_access));
+  for (auto [block, time] : last_access)
+    live.emplace_back(time, block);
+  std::sort(std::begin(live), std::end(live));
+
+  std::size_t timeline = INITIAL_TIMELINE;
+  while (timeline < 2 * std::size(live))
+    timeline *= 2;
+
+  // every renumbered time is marked; build the tree bottom-up
+  tree.assign(timeline + 1, 0);
+  std::fill_n(std::next(std::begin(tree)), std::size(live), 1);
+  for (std::size_t i = 1; i < std::size(tree); ++i) {
+    if (std::size_t parent = i + (i & (0 - i)); parent < std::size(tree))
+      tree[parent] += tree[i];
+  }
+
+  for (std::size_t t = 0; t < std::size(live); ++t)
+    last_access[live[t].second] = t;
+  now = std::size(live);
+}
+
+void stack_distance_profile::access_block(uint64_t block, double scale)
+{
+  if (now + 1 == std::size(tree))
+    compact();
+
+  capacity_accesses++;
+  auto [found, inserted] = last_access.try_emplace(block, now);
+  if (inserted) {
+    capacity_cold++;
+  } else {
+    uint64_t distance = marked_after(found->second);
+    capacity_hist[bucket_of(static_cast<uint64_t>(distance * scale))]++;
+    mark(found->second, -1);
+    found->second = now;
+  }
+
+  mark(now, 1);
+  now++;
+}
+
+void stack_distance_profile::access_set(std::size_t stack, uint64_t block)
+{
+  uint64_t* begin = &set_stacks[stack * depth];
+  uint64_t* end = begin + set_used[stack];
+  uint64_t* found = std::find(begin, end, block);
+
+  way_accesses++;
+  way_hist[found == end ? depth : std::distance(begin, found)]++;
+
+  // move to the front, dropping the deepest block if the stack is full
+  if (found == end && set_used[stack] < depth)
+    set_used[stack]++;
+  else if (found == end)
+    found--;
+  std::copy_backward(begin, found, found + 1);
+  *begin = block;
+}
+
+void stack_distance_profile::reset_stats()
+{
+  capacity_hist.fill(0);
+  capacity_cold = 0;
+  capacity_accesses = 0;
+  std::fill(std::begin(way_hist), std::end(way_hist), 0);
+  way_accesses = 0;
+}
+
+double stack_distance_profile::capacity_miss_ratio(uint64_t blocks) const
+{
+  // distances in bucket b are below 2^b
+  uint64_t hits = 0;
+  for (std::size_t b = 0; b < NUM_BUCKETS && (uint64_t{1} << b) <= blocks; ++b)
+    hits += capacity_hist[b];
+  return 1.0 - (1.0 * hits) / capacity_accesses;
+}
+
+double stack_distance_profile::way_miss_ratio(std::size_t ways) const
+{
+  uint64_t hits = std::accumulate(std::begin(way_hist), std::next(std::begin(way_hist), ways), uint64_t{0});
+  return 1.0 - (1.0 * hits) / way_accesses;
+}
+
+stack_distance_profiler::stack_distance_profiler(std::size_t num_set, std::size_t num_way, double rate)
+    : num_set(num_set), num_way(num_way), rate(rate), threshold(static_cast<uint64_t>(std::ceil(rate * HASH_RANGE))),
+      set_rank(num_set, num_sampled_sets(num_set, rate), [](std::size_t rank) { return static_cast<uint32_t>(rank + 1); })
+{
+  for (std::size_t i = 0; i < NUM_CPUS + 1; ++i)
+    profiles.emplace_back(num_sampled_sets(num_set, rate), 4 * num_way);
+}
+
+void stack_distance_profiler::access(uint32_t cpu, uint64_t block, std::size_t set)
+{
+  if (((block * 0x9e3779b97f4a7c15ull) >> 40) < threshold) {
+    profiles[cpu].access_block(block, 1 / rate);
+    if (NUM_CPUS > 1)
+      profiles[NUM_CPUS].access_block(block, 1 / rate);
+  }
+
+  if (uint32_t rank = set_rank[set]; rank != 0) {
+    profiles[cpu].access_set(rank - 1, block);
+    if (NUM_CPUS > 1)
+      profiles[NUM_CPUS].access_set(rank - 1, block);
+  }
+}
+
+void stack_distance_profiler::reset_stats()
+{
+  for (auto& profile : profiles)
+    profile.reset_stats();
+}
+
+void stack_distance_profiler::print(const std::string& name) const
+{
+  std::cout << std::endl << name << " LRU miss ratio curves (sampling rate " << rate << ")" << std::endl;
+
+  for (std::size_t i = 0; i < std::size(profiles); ++i) {
+    const auto& profile = profiles[i];
+    if (profile.capacity_accesses == 0 && profile.way_accesses == 0)
+      continue;
+
+    std::string who = name + (i < NUM_CPUS ? " CPU " + std::to_string(i) : std::string{" ALL CPUS"});
+
+    // fully associative, from a single way's worth of blocks to 16 times this cache
+    if (profile.capacity_accesses > 0) {
+      for (uint64_t blocks = uint64_t{1} << (63 - __builtin_clzll(num_set)); blocks <= 16 * num_set * num_way; blocks *= 2)
+        std::cout << who << " CAPACITY: " << std::setw(10) << blocks << " blocks (" << std::setw(8) << blocks * BLOCK_SIZE / 1024
+                  << " KiB)  MISS RATIO: " << profile.capacity_miss_ratio(blocks) << std::endl;
+    }
+
+    // with this cache's sets
+    if (profile.way_accesses > 0) {
+      for (std::size_t ways = 1; ways < std::size(profile.way_hist); ++ways)
+        std::cout << who << " WAYS: " << std::setw(3) << ways << " (" << num_set << " sets)  MISS RATIO: " << profile.way_miss_ratio(ways) << std::endl;
+    }
+  }
+}
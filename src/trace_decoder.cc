@@ -0,0 +1,448 @@
+/*
+ *    Copyright 2023 The ChampSim Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_decoder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <optional>
+
+#include <lzma.h>
+#include <zlib.h>
+
+#include "compact_trace.h"
+
+using namespace champsim;
+
+namespace
+{
+constexpr std::size_t INPUT_BYTES = 1 << 16;
+
+// compressed bytes, from a file or from wget
+class compressed_input
+{
+  FILE* fp;
+  bool piped;
+
+public:
+  explicit compressed_input(const std::string& path) : piped(path.substr(0, 4) == "http")
+  {
+    if (piped)
+      fp = popen(("wget -qO- -o /dev/null " + path).c_str(), "r");
+    else
+      fp = std::fopen(path.c_str(), "rb");
+
+    if (fp == nullptr) {
+      std::cerr << std::endl << "*** CANNOT OPEN TRACE FILE: " << path << " ***" << std::endl;
+      assert(0);
+    }
+  }
+
+  ~compressed_input()
+  {
+    if (piped)
+      pclose(fp);
+    else
+      std::fclose(fp);
+  }
+
+  std::size_t read(uint8_t* buf, std::size_t n) { return std::fread(buf, 1, n, fp); }
+
+  // only files can be read out of order
+  bool seekable() const { return !piped; }
+  bool seek(uint64_t offset) { return seekable() && fseeko(fp, static_cast<off_t>(offset), SEEK_SET) == 0; }
+
+  uint64_t size()
+  {
+    off_t here = ftello(fp);
+    fseeko(fp, 0, SEEK_END);
+    off_t end = ftello(fp);
+    fseeko(fp, here, SEEK_SET);
+    return static_cast<uint64_t>(end);
+  }
+};
+
+class decompressor
+{
+protected:
+  compressed_input input;
+  uint8_t inbuf[INPUT_BYTES];
+
+public:
+  explicit decompressor(const std::string& path) : input(path) {}
+  virtual ~decompressor() = default;
+
+  // decompress up to n bytes into out; fewer only at the end of the trace
+  virtual std::size_t read(uint8_t* out, std::size_t n) = 0;
+
+  // move past the first bytes of the trace before anything is read; false if the trace is shorter
+  virtual bool skip(uint64_t bytes)
+  {
+    auto scratch = std::make_unique<uint8_t[]>(INPUT_BYTES);
+    while (bytes > 0) {
+      std::size_t n = read(scratch.get(), std::min<uint64_t>(bytes, INPUT_BYTES));
+      if (n == 0)
+        return false;
+      bytes -= n;
+    }
+    return true;
+  }
+};
+
+class xz_decompressor : public decompressor
+{
+  lzma_stream strm = LZMA_STREAM_INIT;
+  bool finished = false;
+  uint64_t remaining = UINT64_MAX;
+
+  // restart the decoder at the block holding the target offset, using the index of a single-stream file;
+  // returns the uncompressed offset of that block
+  uint64_t seek_block(uint64_t target)
+  {
+    if (!input.seekable())
+      return 0;
+
+    uint64_t file_size = input.size();
+    uint8_t header_bytes[LZMA_STREAM_HEADER_SIZE], footer_bytes[LZMA_STREAM_HEADER_SIZE];
+    lzma_stream_flags header, footer;
+    if (file_size < 2 * LZMA_STREAM_HEADER_SIZE || !input.seek(0) || input.read(header_bytes, sizeof(header_bytes)) != sizeof(header_bytes)
+        || !input.seek(file_size - LZMA_STREAM_HEADER_SIZE) || input.read(footer_bytes, sizeof(footer_bytes)) != sizeof(footer_bytes)
+        || lzma_stream_header_decode(&header, header_bytes) != LZMA_OK || lzma_stream_footer_decode(&footer, footer_bytes) != LZMA_OK
+        || footer.backward_size > file_size - 2 * LZMA_STREAM_HEADER_SIZE) {
+      input.seek(0);
+      return 0;
+    }
+
+    std::vector<uint8_t> index_bytes(footer.backward_size);
+    lzma_index* index = nullptr;
+    uint64_t memlimit = UINT64_MAX;
+    std::size_t pos = 0;
+    if (!input.seek(file_size - LZMA_STREAM_HEADER_SIZE - footer.backward_size) || input.read(index_bytes.data(), index_bytes.size()) != index_bytes.size()
+        || lzma_index_buffer_decode(&index, &memlimit, nullptr, index_bytes.data(), &pos, index_bytes.size()) != LZMA_OK) {
+      input.seek(0);
+      return 0;
+    }
+
+    lzma_index_iter iter;
+    lzma_index_iter_init(&iter, index);
+    bool found = lzma_index_file_size(index) == file_size && !lzma_index_iter_locate(&iter, target);
+    uint64_t total = lzma_index_uncompressed_size(index);
+    lzma_index_end(index, nullptr);
+
+    if (!found || iter.block.uncompressed_file_offset == 0) {
+      input.seek(0);
+      return 0;
+    }
+
+    // the decoder sees the stream header, then the blocks from this one on; the index at the end no longer matches them,
+    // so stop at the end of the data instead
+    input.seek(iter.block.compressed_file_offset);
+    std::memcpy(inbuf, header_bytes, sizeof(header_bytes));
+    strm.next_in = inbuf;
+    strm.avail_in = sizeof(header_bytes);
+    remaining = total - iter.block.uncompressed_file_offset;
+    return iter.block.uncompressed_file_offset;
+  }
+
+public:
+  explicit xz_decompressor(const std::string& path) : decompressor(path)
+  {
+    [[maybe_unused]] lzma_ret ret = lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED);
+    assert(ret == LZMA_OK);
+  }
+
+  ~xz_decompressor() { lzma_end(&strm); }
+
+  std::size_t read(uint8_t* out, std::size_t n) override
+  {
+    n = std::min<uint64_t>(n, remaining);
+    strm.next_out = out;
+    strm.avail_out = n;
+    while (strm.avail_out > 0 && !finished) {
+      lzma_action action = LZMA_RUN;
+      if (strm.avail_in == 0) {
+        strm.next_in = inbuf;
+        strm.avail_in = input.read(inbuf, sizeof(inbuf));
+        if (strm.avail_in == 0)
+          action = LZMA_FINISH;
+      }
+
+      lzma_ret ret = lzma_code(&strm, action);
+      if (ret == LZMA_STREAM_END || (ret == LZMA_BUF_ERROR && action == LZMA_FINISH)) {
+        finished = true; // a truncated trace ends where the data does
+      } else if (ret != LZMA_OK && n - strm.avail_out == remaining) {
+        finished = true; // after a seek, the decoder reached the index with all of the data out
+      } else if (ret != LZMA_OK) {
+        std::cerr << "*** CORRUPT XZ TRACE (liblzma error " << ret << ") ***" << std::endl;
+        assert(0);
+      }
+    }
+
+    remaining -= n - strm.avail_out;
+    finished = finished || remaining == 0;
+    return n - strm.avail_out;
+  }
+
+  bool skip(uint64_t bytes) override { return decompressor::skip(bytes - seek_block(bytes)); }
+};
+
+class gz_decompressor : public decompressor
+{
+  z_stream strm = {};
+  bool finished = false;
+
+public:
+  explicit gz_decompressor(const std::string& path) : decompressor(path)
+  {
+    [[maybe_unused]] int ret = inflateInit2(&strm, 16 + MAX_WBITS); // expect a gzip header
+    assert(ret == Z_OK);
+  }
+
+  ~gz_decompressor() { inflateEnd(&strm); }
+
+  std::size_t read(uint8_t* out, std::size_t n) override
+  {
+    strm.next_out = out;
+    strm.avail_out = static_cast<uInt>(n);
+    while (strm.avail_out > 0 && !finished) {
+      if (strm.avail_in == 0) {
+        strm.next_in = inbuf;
+        strm.avail_in = static_cast<uInt>(input.read(inbuf, sizeof(inbuf)));
+        if (strm.avail_in == 0) {
+          finished = true; // a truncated trace ends where the data does
+          break;
+        }
+      }
+
+      int ret = inflate(&strm, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+        // gzip files may hold several members back to back
+        inflateReset(&strm);
+      } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        std::cerr << "*** CORRUPT GZIP TRACE (zlib error " << ret << ") ***" << std::endl;
+        assert(0);
+      }
+    }
+    return n - strm.avail_out;
+  }
+};
+
+class compact_decompressor : public decompressor
+{
+  const std::string index_path;
+  std::vector<uint8_t> encoded;
+  std::vector<input_instr> block;
+  std::size_t taken = 0;
+
+  // the offset of block number n, from the sidecar index written by champsim_compact
+  std::optional<uint64_t> indexed_offset(uint64_t n)
+  {
+    FILE* index = std::fopen(index_path.c_str(), "rb");
+    if (index == nullptr)
+      return std::nullopt;
+
+    uint64_t offset;
+    bool found = fseeko(index, static_cast<off_t>(n * sizeof(offset)), SEEK_SET) == 0 && std::fread(&offset, sizeof(offset), 1, index) == 1;
+    std::fclose(index);
+    return found ? std::optional{offset} : std::nullopt;
+  }
+
+  bool next_block()
+  {
+    compact_trace::block_header header;
+    if (input.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header))
+      return false; // a truncated trace ends where the data does
+
+    encoded.resize(header.bytes);
+    block.resize(header.records);
+    taken = 0;
+    if (header.records > compact_trace::BLOCK_RECORDS || input.read(encoded.data(), header.bytes) != header.bytes
+        || !compact_trace::decode_block(header, encoded.data(), block.data())) {
+      std::cerr << "*** CORRUPT COMPACT TRACE ***" << std::endl;
+      assert(0);
+    }
+    return true;
+  }
+
+public:
+  explicit compact_decompressor(const std::string& path) : decompressor(path), index_path(path + ".idx")
+  {
+    char magic[sizeof(compact_trace::MAGIC)];
+    if (input.read(reinterpret_cast<uint8_t*>(magic), sizeof(magic)) != sizeof(magic) || std::memcmp(magic, compact_trace::MAGIC, sizeof(magic)) != 0) {
+      std::cerr << "*** NOT A COMPACT TRACE: " << path << " ***" << std::endl;
+      assert(0);
+    }
+  }
+
+  std::size_t read(uint8_t* out, std::size_t n) override
+  {
+    std::size_t done = 0;
+    while (done < n && (taken < std::size(block) || next_block())) {
+      std::size_t bytes = std::min(n - done, (std::size(block) - taken) * sizeof(input_instr));
+      std::memcpy(out + done, reinterpret_cast<const uint8_t*>(block.data() + taken), bytes);
+      done += bytes;
+      taken += bytes / sizeof(input_instr);
+    }
+    return done;
+  }
+
+  bool skip(uint64_t bytes) override
+  {
+    uint64_t records = bytes / sizeof(input_instr);
+    if (input.seekable()) {
+      // every block but the last holds BLOCK_RECORDS instructions, so the index can be looked up directly
+      uint64_t n = records / compact_trace::BLOCK_RECORDS;
+      if (auto indexed = indexed_offset(n); indexed.has_value() && input.seek(*indexed)) {
+        records -= n * compact_trace::BLOCK_RECORDS;
+      } else {
+        // without an index, step over whole blocks by their headers
+        uint64_t offset = sizeof(compact_trace::MAGIC);
+        compact_trace::block_header header;
+        while (input.seek(offset) && input.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header) && header.records <= records) {
+          records -= header.records;
+          offset += sizeof(header) + header.bytes;
+        }
+        input.seek(offset);
+      }
+    }
+
+    return decompressor::skip(records * sizeof(input_instr));
+  }
+};
+
+std::unique_ptr<decompressor> open_trace(const std::string& path, std::size_t record_size)
+{
+  std::string last_dot = path.substr(path.find_last_of("."));
+  if (last_dot[1] == 'g') // gzip format
+    return std::make_unique<gz_decompressor>(path);
+  if (last_dot[1] == 'x') // xz
+    return std::make_unique<xz_decompressor>(path);
+  if (last_dot[1] == 'c' && record_size == sizeof(input_instr)) // compact
+    return std::make_unique<compact_decompressor>(path);
+
+  std::cout << "ChampSim does not support traces other than gz, xz or (non-cloudsuite) cst!" << std::endl;
+  assert(0);
+  return nullptr;
+}
+} // namespace
+
+trace_decoder::trace_decoder(std::string path, std::size_t record_size, uint64_t skip_instructions)
+    : path(path), record_size(record_size), capacity(CHUNK_BYTES / record_size * record_size), skip_instructions(skip_instructions)
+{
+  worker = std::thread{&trace_decoder::run, this};
+}
+
+trace_decoder::~trace_decoder()
+{
+  {
+    std::lock_guard lock{mutex};
+    stopping = true;
+  }
+  wanted.notify_all();
+  worker.join();
+}
+
+std::size_t trace_decoder::attach()
+{
+  std::lock_guard lock{mutex};
+  cursors.push_back(0);
+  return cursors.size() - 1;
+}
+
+void trace_decoder::detach(std::size_t reader)
+{
+  std::lock_guard lock{mutex};
+  cursors.at(reader) = UINT64_MAX;
+}
+
+auto trace_decoder::get(std::size_t reader, uint64_t index) -> std::shared_ptr<const chunk>
+{
+  std::unique_lock lock{mutex};
+  if (index < first)
+    return nullptr;
+
+  cursors.at(reader) = index;
+  if (index >= furthest) {
+    furthest = index;
+    wanted.notify_one();
+  }
+
+  decoded.wait(lock, [&] { return index < produced(); });
+  return window[index - first];
+}
+
+void trace_decoder::run()
+{
+  auto source = open_trace(path, record_size);
+  std::size_t pass_bytes = 0;
+
+  if (!source->skip(skip_instructions * record_size)) {
+    std::cerr << "*** TRACE HAS FEWER THAN " << skip_instructions << " INSTRUCTIONS TO SKIP: " << path << " ***" << std::endl;
+    assert(0);
+  }
+
+  std::unique_lock lock{mutex};
+  while (true) {
+    wanted.wait(lock, [&] { return stopping || produced() < furthest + RING_SIZE; });
+    if (stopping)
+      break;
+
+    auto c = std::make_shared<chunk>();
+    if (!std::empty(spare)) {
+      c->data = std::move(spare.back());
+      spare.pop_back();
+    } else {
+      c->data = std::make_unique<uint8_t[]>(capacity);
+    }
+
+    // decompress without holding up the readers
+    lock.unlock();
+    c->size = source->read(c->data.get(), capacity);
+    c->end_of_trace = (c->size < capacity);
+    pass_bytes += c->size;
+
+    if (c->end_of_trace) {
+      // a partial record at the very end is dropped
+      c->size -= c->size % record_size;
+      if (pass_bytes < record_size) {
+        std::cerr << "*** TRACE HOLDS NO INSTRUCTIONS: " << path << " ***" << std::endl;
+        assert(0);
+      }
+
+      source.reset();
+      source = open_trace(path, record_size);
+      pass_bytes = 0;
+    }
+    lock.lock();
+
+    window.push_back(std::move(c));
+
+    // drop chunks every reader is done with, and chunks too far behind the furthest reader
+    uint64_t slowest = std::empty(cursors) ? 0 : *std::min_element(std::begin(cursors), std::end(cursors));
+    while (!std::empty(window) && (first < slowest || std::size(window) > RING_SIZE + MAX_LAG)) {
+      // nobody else can take a reference to a chunk outside of the lock
+      if (window.front().use_count() == 1)
+        spare.push_back(std::move(window.front()->data));
+      window.pop_front();
+      ++first;
+    }
+
+    decoded.notify_all();
+  }
+}
@@ -20,9 +20,13 @@
 #include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
+#include <tuple>
+#include <utility>
 
-tracereader::tracereader(uint8_t cpu, std::string _ts) : cpu(cpu), trace_string(_ts)
+tracereader::tracereader(uint8_t cpu, std::string _ts, std::size_t record_size, std::string cache_dir, uint64_t skip_instructions)
+    : cpu(cpu), trace_string(_ts), record_size(record_size), cache_dir(cache_dir), skip_instructions(skip_instructions)
 {
   std::string last_dot = trace_string.substr(trace_string.find_last_of("."));
 
@@ -35,22 +39,16 @@ tracereader::tracereader(uint8_t cpu, std::string _ts) : cpu(cpu), trace_string(
       std::cerr << "TRACE FILE NOT FOUND" << std::endl;
       assert(0);
     }
-    cmd_fmtstr = "wget -qO- -o /dev/null %2$s | %1$s -dc";
   } else {
     std::ifstream testfile(trace_string);
     if (!testfile.good()) {
       std::cerr << "TRACE FILE NOT FOUND" << std::endl;
       assert(0);
     }
-    cmd_fmtstr = "%1$s -dc %2$s";
   }
 
-  if (last_dot[1] == 'g') // gzip format
-    decomp_program = "gzip";
-  else if (last_dot[1] == 'x') // xz
-    decomp_program = "xz";
-  else {
-    std::cout << "ChampSim does not support traces other than gz or xz compression!" << std::endl;
+  if (last_dot[1] != 'g' && last_dot[1] != 'x' && (last_dot[1] != 'c' || record_size != sizeof(input_instr))) {
+    std::cout << "ChampSim does not support traces other than gz, xz or (non-cloudsuite) cst!" << std::endl;
     assert(0);
   }
 
@@ -59,41 +57,96 @@ tracereader::tracereader(uint8_t cpu, std::string _ts) : cpu(cpu), trace_string(
 
 tracereader::~tracereader() { close(); }
 
+namespace
+{
+// trace sources still in use by some reader, by trace, record size and instructions skipped
 template <typename T>
-ooo_model_instr tracereader::read_single_instr()
+using source_map = std::map<std::tuple<std::string, std::size_t, uint64_t>, std::weak_ptr<T>>;
+
+template <typename T, typename... Args>
+std::shared_ptr<T> shared_source(source_map<T>& sources, typename source_map<T>::key_type key, Args&&... args)
 {
-  T trace_read_instr;
+  auto& entry = sources[key];
+  auto source = entry.lock();
+  if (!source) {
+    source = std::make_shared<T>(std::forward<Args>(args)...);
+    entry = source;
+  }
+  return source;
+}
 
-  while (!fread(&trace_read_instr, sizeof(T), 1, trace_file)) {
-    // reached end of file for this trace
-    std::cout << "*** Reached end of trace: " << trace_string << std::endl;
+source_map<champsim::mapped_trace> mappings;
+source_map<champsim::trace_decoder> decoders;
+} // namespace
 
-    // close the trace file and re-open it
-    close();
-    open(trace_string);
+void tracereader::open(std::string trace_string)
+{
+  // remote traces are never cached
+  if (!cache_dir.empty() && trace_string.substr(0, 4) != "http") {
+    // the mapping holds the whole trace whatever is skipped
+    mapping = shared_source(mappings, {trace_string, record_size, 0}, trace_string, record_size, cache_dir);
+    if (skip_instructions >= static_cast<uint64_t>(mapping->end() - mapping->begin()) / record_size) {
+      std::cerr << "*** TRACE HAS FEWER THAN " << skip_instructions << " INSTRUCTIONS TO SKIP: " << trace_string << " ***" << std::endl;
+      assert(0);
+    }
+    next = mapping->begin() + skip_instructions * record_size;
+    end = mapping->end();
+  } else {
+    decoder = shared_source(decoders, {trace_string, record_size, skip_instructions}, trace_string, record_size, skip_instructions);
+    reader = decoder->attach();
+    chunk_index = 0;
+    chunk_position = skip_instructions;
+    fetch_chunk();
   }
+}
+
+void tracereader::close()
+{
+  if (decoder)
+    decoder->detach(reader);
 
-  // copy the instruction into the performance model's instruction format
-  ooo_model_instr retval(cpu, trace_read_instr);
-  return retval;
+  mapping.reset();
+  decoder.reset();
+  current.reset();
+  next = end = nullptr;
 }
 
-void tracereader::open(std::string trace_string)
+void tracereader::fetch_chunk()
 {
-  char gunzip_command[4096];
-  sprintf(gunzip_command, cmd_fmtstr.c_str(), decomp_program.c_str(), trace_string.c_str());
-  trace_file = popen(gunzip_command, "r");
-  if (trace_file == NULL) {
-    std::cerr << std::endl << "*** CANNOT OPEN TRACE FILE: " << trace_string << " ***" << std::endl;
-    assert(0);
+  current = decoder->get(reader, chunk_index);
+  if (!current) {
+    // too far behind the other readers of this trace to share their chunks; seek to where this one is
+    std::cout << "*** CPU " << +cpu << " decodes " << trace_string << " on its own from instruction " << chunk_position << std::endl;
+    decoder->detach(reader);
+    decoder = std::make_shared<champsim::trace_decoder>(trace_string, record_size, chunk_position);
+    reader = decoder->attach();
+    chunk_index = 0;
+    current = decoder->get(reader, chunk_index);
   }
+
+  next = current->data.get();
+  end = next + current->size;
 }
 
-void tracereader::close()
+void tracereader::refill()
 {
-  if (trace_file != NULL) {
-    pclose(trace_file);
+  if (mapping) {
+    // reached end of file for this trace
+    std::cout << "*** Reached end of trace: " << trace_string << std::endl;
+    next = mapping->begin();
+    return;
   }
+
+  // reached end of file for this trace; the decoder has already started over
+  if (current->end_of_trace) {
+    std::cout << "*** Reached end of trace: " << trace_string << std::endl;
+    chunk_position = 0;
+  } else {
+    chunk_position += current->size / record_size;
+  }
+
+  ++chunk_index;
+  fetch_chunk();
 }
 
 class cloudsuite_tracereader : public tracereader
@@ -102,7 +155,10 @@ class cloudsuite_tracereader : public tracereader
   bool initialized = false;
 
 public:
-  cloudsuite_tracereader(uint8_t cpu, std::string _tn) : tracereader(cpu, _tn) {}
+  cloudsuite_tracereader(uint8_t cpu, std::string _tn, std::string cache_dir, uint64_t skip_instructions)
+      : tracereader(cpu, _tn, sizeof(cloudsuite_instr), cache_dir, skip_instructions)
+  {
+  }
 
   ooo_model_instr get()
   {
@@ -127,7 +183,10 @@ class input_tracereader : public tracereader
   bool initialized = false;
 
 public:
-  input_tracereader(uint8_t cpu, std::string _tn) : tracereader(cpu, _tn) {}
+  input_tracereader(uint8_t cpu, std::string _tn, std::string cache_dir, uint64_t skip_instructions)
+      : tracereader(cpu, _tn, sizeof(input_instr), cache_dir, skip_instructions)
+  {
+  }
 
   ooo_model_instr get()
   {
@@ -146,11 +205,11 @@ public:
   }
 };
 
-tracereader* get_tracereader(std::string fname, uint8_t cpu, bool is_cloudsuite)
+tracereader* get_tracereader(std::string fname, uint8_t cpu, bool is_cloudsuite, std::string cache_dir, uint64_t skip_instructions)
 {
   if (is_cloudsuite) {
-    return new cloudsuite_tracereader(cpu, fname);
+    return new cloudsuite_tracereader(cpu, fname, cache_dir, skip_instructions);
   } else {
-    return new input_tracereader(cpu, fname);
+    return new input_tracereader(cpu, fname, cache_dir, skip_instructions);
   }
 }